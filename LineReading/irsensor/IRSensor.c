@@ -3,10 +3,20 @@
 #include "hardware/gpio.h"
 #include "hardware/timer.h"
 #include "hardware/adc.h"
+#include "hot_path.h"
+#include "instrument.h"
+#ifdef PIPELINE_MODE
+#include "sample_pipe.h"
+#endif
+#ifdef PERF_BENCH
+#include "perf_bench.h"
+#endif
 
 #define LINE_SENSOR_PIN 26  // GPIO 26 connected to the line sensor's digital output
 #define NUM_SAMPLES 10       // Number of samples for averaging
 #define THRESHOLD 1500         // Threshold for ADC readings
+#define SAMPLE_PERIOD_MS 20    // Time between ADC readings
+#define STATS_PERIOD_US 10000000 // Pipeline counters every 10 seconds
 
 volatile uint64_t black_start_time, black_end_time, white_start_time, white_end_time;
 volatile bool measuring_black = false;
@@ -16,6 +26,15 @@ uint16_t moving_avg_values[NUM_SAMPLES] = {0}; // Store moving average values
 uint8_t moving_avg_index = 0; // Index for moving average values
 uint32_t moving_avg_total = 0; // Total for moving average
 
+// Printed as INSTR snapshots when built with -DINSTRUMENT=ON (tools/instr_report.py).
+// A sample has to be dealt with before the next one is due.
+INSTR_HISTOGRAM(process_time, "ir_process", SAMPLE_PERIOD_MS * 1000);
+#ifdef PIPELINE_MODE
+// ADC read on core 1 to processed on core 0; in the single core build that is just ir_process
+INSTR_HISTOGRAM(sample_age, "ir_sample_age", SAMPLE_PERIOD_MS * 1000);
+#endif
+INSTR_COUNTER(line_changes, "ir_line_changes");
+
 void setup() {
     stdio_init_all();
     gpio_init(LINE_SENSOR_PIN);
@@ -27,7 +46,7 @@ void setup() {
     adc_select_input(0); // Select ADC input 0 (GP27)
 }
 
-uint16_t moving_average(uint16_t new_value) {
+uint16_t HOT_FUNC(moving_average)(uint16_t new_value) {
     // Check if color has changed
     bool is_black = (new_value > THRESHOLD); // Black line detected
 
@@ -52,9 +71,9 @@ uint16_t moving_average(uint16_t new_value) {
     return moving_avg_total / NUM_SAMPLES; // Return the average
 }
 
-void loop() {
-    // Read the analog value from the sensor
-    uint16_t analog_value = adc_read(); // Read ADC value (0-4095)
+// Filters one reading taken at time `now` (us) and reports line edges and pulse widths
+void processSample(uint16_t analog_value, uint64_t now) {
+    INSTR_SCOPE(process_time);
     uint16_t filtered_value = moving_average(analog_value); //Used to filter the ADC using moving average
 
     //Used for testing
@@ -64,14 +83,15 @@ void loop() {
 
     if (filtered_value > THRESHOLD) { // ADC > 400  (black line detected)
         if (!measuring_black) {
-            black_start_time = time_us_64(); // Start the timer for black line
+            black_start_time = now; // Start the timer for black line
             measuring_black = true; // Indicate that measuring has started for black line
+            INSTR_COUNT(line_changes);
             printf("Black Line Detected\n");
         }
 
         // If we are measuring a white surface, calculate the pulse width
         if (measuring_white) {
-            white_end_time = time_us_64(); // Stop the timer for white surface
+            white_end_time = now; // Stop the timer for white surface
             uint64_t pulse_width_white = white_end_time - white_start_time; // Calculate pulse width for white surface
             printf("Pulse Width (White Surface): %.6f seconds\n", pulse_width_white / 1000000.0);
             measuring_white = false; // Indicate that measuring has stopped for white surface
@@ -81,7 +101,7 @@ void loop() {
     else // ADC < 400> state (White line detected) 
     {
          if (measuring_black) {
-            black_end_time = time_us_64(); // Stop the timer for black line
+            black_end_time = now; // Stop the timer for black line
             uint64_t pulse_width_black = black_end_time - black_start_time; // Calculate pulse width for black line
             printf("Pulse Width (Black Line): %.6f seconds\n", pulse_width_black / 1000000.0);
             measuring_black = false; // Indicate that measuring has stopped for black line
@@ -89,22 +109,83 @@ void loop() {
         
         // Handle white line detection
         if (!measuring_white) {
-            white_start_time = time_us_64(); // Start the timer for white surface
+            white_start_time = now; // Start the timer for white surface
             measuring_white = true; // Indicate that measuring has started for white surface
+            INSTR_COUNT(line_changes);
             printf("White Line Detected\n");
         }
        
     }
+}
+
+void loop() {
+    // Read the analog value from the sensor
+    uint16_t analog_value = adc_read(); // Read ADC value (0-4095)
+    processSample(analog_value, time_us_64());
+    INSTR_SNAPSHOT_POLL();
+
+    sleep_ms(SAMPLE_PERIOD_MS);
+}
+
+#ifdef PIPELINE_MODE
+// Core 1: samples the sensor on a fixed schedule and timestamps each reading
+void acquisitionLoop() {
+    absolute_time_t next_sample = get_absolute_time();
+    while (1) {
+        sample_t sample = {
+            .timestamp_us = time_us_32(),
+            .kind = SAMPLE_ADC,
+            .channel = 0,
+            .value = adc_read(),
+        };
+        sample_pipe_push(&sample);
+
+        next_sample = delayed_by_ms(next_sample, SAMPLE_PERIOD_MS);
+        sleep_until(next_sample);
+    }
+}
 
-    sleep_ms(20); 
+// Core 0: filtering and printing, timed by when each sample was taken rather than when it arrives
+void processingLoop() {
+    uint32_t last_stats = time_us_32();
+    sample_t sample;
+    while (1) {
+        sample_pipe_pop(&sample, true);
+        processSample((uint16_t)sample.value, sample_pipe_time_us_64(&sample));
+        INSTR_RECORD(sample_age, time_us_32() - sample.timestamp_us);
+        sample_pipe_done(&sample);
+
+        if (time_us_32() - last_stats >= STATS_PERIOD_US) {
+            last_stats = time_us_32();
+            sample_pipe_print_stats();
+        }
+        INSTR_SNAPSHOT_POLL();
+    }
 }
+#endif
 
 int main() 
 {
     setup();
+    INSTR_REGISTER_HISTOGRAM(process_time);
+#ifdef PIPELINE_MODE
+    INSTR_REGISTER_HISTOGRAM(sample_age);
+#endif
+    INSTR_REGISTER_COUNTER(line_changes);
+#ifdef PERF_BENCH
+    perf_bench_wait_console();
+    PERF_BENCH_RUN("ir_moving_avg", 10000,
+        perf_bench_sink += moving_average((uint16_t)(perf_bench_i & 0xfff)));
+    PERF_BENCH_RUN("ir_adc_read", 1000, perf_bench_sink += adc_read());
+#endif
+#ifdef PIPELINE_MODE
+    sample_pipe_launch(acquisitionLoop);
+    processingLoop();
+#else
     while (1) {
         loop();
     }
+#endif
     return 0;
 }
 
@@ -3,15 +3,49 @@
 #include "hardware/gpio.h"
 #include "hardware/timer.h"
 #include "hardware/adc.h"
+#include "hot_path.h"
+#include "range_filter.h"
+#include "instrument.h"
+#ifdef PIPELINE_MODE
+#include "sample_pipe.h"
+#endif
+#ifdef PERF_BENCH
+#include "perf_bench.h"
+#endif
 
 #define EchoPin 0
 #define TrigPin 1
 #define EncoderPin 2
 #define NumofSamples 10
+#define ControlPeriodMs 20      // Rate the distance estimate is updated at
+#define PingEveryNTicks 5       // Ultrasonic ping every 100 ms (HC-SR04 needs >= 60 ms between pings)
+#define PrintEveryNTicks 50     // Print the estimate once a second
+#define EncoderSlots 20         // Slots in the encoder disc (rising edges per wheel revolution)
+#define WheelCircumferenceMm 204 // 65 mm wheel
+#define SlotQ8 (RANGE_Q8(WheelCircumferenceMm) / EncoderSlots) // travel per slot, Q8 mm
+#define TempAdcInput 4
+
+// In the pipeline build core 1 does the acquisition and must not stall on the USB console,
+// so the per-measurement debug output is compiled out there
+#ifdef PIPELINE_MODE
+#define debug_printf(...)
+#else
+#define debug_printf(...) printf(__VA_ARGS__)
+#endif
+
 const int timeout = 50000; // Increased timeout for pulse detection
 volatile static absolute_time_t rise_time;
 volatile static absolute_time_t fall_time;
 volatile static uint64_t pulse_width_us = 0;
+volatile static uint32_t encoder_ticks = 0;
+volatile static uint32_t encoder_edge_us = 0; // time_us_32() of the rising edge that made encoder_ticks
+
+// Stage timings, printed as INSTR snapshots when built with -DINSTRUMENT=ON (tools/instr_report.py)
+INSTR_HISTOGRAM(tick_time, "us_tick", ControlPeriodMs * 1000);        // work per tick, has to fit the period
+INSTR_HISTOGRAM(sample_age, "us_sample_age", ControlPeriodMs * 1000); // reading taken to result in the filter
+INSTR_HISTOGRAM(process_time, "us_process", 0);                       // filter work per tick/sample
+INSTR_COUNTER(echo_timeouts, "us_echo_timeouts");
+INSTR_COUNTER(echo_rejected, "us_echo_rejected");
 
 void setupPins() {
     // Initialize ADC
@@ -31,7 +65,7 @@ void setupPins() {
     gpio_set_dir(EncoderPin, GPIO_IN);
 }
 
-void __not_in_flash_func(adc_capture)(float *buf) {
+void HOT_FUNC(adc_capture)(float *buf) {
     adc_select_input(4); // Ensure selecting input 4 for temperature sensor
 
     // Configure ADC FIFO
@@ -57,7 +91,7 @@ void __not_in_flash_func(adc_capture)(float *buf) {
     adc_fifo_drain(); // Clear the FIFO
 }
 
-float movingAvgofSpeed(float value, float *buffer, int *index, float *sum) {
+float HOT_FUNC(movingAvgofSpeed)(float value, float *buffer, int *index, float *sum) {
     *sum -= buffer[*index];       // Subtract the oldest value
     buffer[*index] = value;       // Store the new value
     *sum += value;                // Add the new value to the sum
@@ -82,6 +116,16 @@ float computeTotalVolt(float *buf) {
     return totalVolt;
 }
 
+float soundSpeedFromVolt(float voltage) {
+    // Calculate temperature based on voltage
+    float temperature = 27 - ((voltage - 0.706) / 0.001721);
+
+    // Calculate speed of sound based on temperature
+    float soundSpeed = 331 + (0.61 * temperature);
+
+    return soundSpeed;
+}
+
 float getSoundOfSpeed() {
     static float sample_buf[NumofSamples] = {0.0f};
     static int index = 0;
@@ -100,17 +144,11 @@ float getSoundOfSpeed() {
     float value = raw_value * conversion_factor;
 
     total_voltage = movingAvgofSpeed(value, sample_buf, &index, &sum);
- 
-    // Calculate temperature based on voltage
-    float temperature = 27 - ((total_voltage - 0.706) / 0.001721);
-
-    // Calculate speed of sound based on temperature
-    float soundSpeed = 331 + (0.61 * temperature);
 
-    return soundSpeed;
+    return soundSpeedFromVolt(total_voltage);
 }
 
-uint64_t getPulse() {
+uint64_t HOT_FUNC(getPulse)() {
     // Trigger ultrasonic pulse
     gpio_put(TrigPin, 1);
     sleep_us(10); // Send a 10us pulse to trigger
@@ -120,7 +158,7 @@ uint64_t getPulse() {
     absolute_time_t startTime = get_absolute_time();
     while (gpio_get(EchoPin) == 0) {
         if (absolute_time_diff_us(startTime, get_absolute_time()) > timeout) {
-            printf("EchoPin HIGH timeout\n"); // Debugging statement
+            debug_printf("EchoPin HIGH timeout\n"); // Debugging statement
             return 0; // Timeout, no pulse detected
         }
     }
@@ -129,19 +167,26 @@ uint64_t getPulse() {
     absolute_time_t pulseStart = get_absolute_time();
     while (gpio_get(EchoPin) == 1) {
         if (absolute_time_diff_us(pulseStart, get_absolute_time()) > timeout) {
-            printf("EchoPin LOW timeout\n"); // Debugging statement
+            debug_printf("EchoPin LOW timeout\n"); // Debugging statement
             return 0; // Timeout, pulse too long
         }
     }
     absolute_time_t pulseEnd = get_absolute_time();
 
     uint64_t pulse_duration = absolute_time_diff_us(pulseStart, pulseEnd);
-    printf("Pulse duration: %llu us\n", pulse_duration); // Debugging statement
+    debug_printf("Pulse duration: %llu us\n", pulse_duration); // Debugging statement
     return pulse_duration; // Pulse width in microseconds
 }
 
-uint64_t getCm() {
-    uint64_t pulseLength = getPulse();
+float pulseToMm(uint64_t pulseLength, float soundSpeed) {
+    // Calculate distance in millimetres
+    // Distance = (Time * Speed of Sound) / 2
+    // Convert pulseLength from microseconds to seconds
+    return ((float)pulseLength / 1e6) * soundSpeed / 2.0f * 1000.0f; // Convert to mm
+}
+
+// Distance for an echo width from getPulse(), 0 if there was no echo
+float echoToMm(uint64_t pulseLength) {
     float soundSpeed = getSoundOfSpeed();
 
     if (pulseLength == 0 || soundSpeed < 331) {
@@ -149,22 +194,39 @@ uint64_t getCm() {
         return 0; // No valid pulse detected or temperature too low
     }
 
-    // Calculate distance in centimeters
-    // Distance = (Time * Speed of Sound) / 2
-    // Convert pulseLength from microseconds to seconds
-    float distance = ((float)pulseLength / 1e6) * soundSpeed / 2.0f * 100.0f; // Convert to cm
-    return (uint64_t)distance;
+    return pulseToMm(pulseLength, soundSpeed);
 }
 
-void IRQcallback(uint gpio, uint32_t events) {
+float getMm() {
+    return echoToMm(getPulse());
+}
+
+uint64_t getCm() {
+    return (uint64_t)(getMm() / 10.0f);
+}
+
+// Encoder slot count and the time of the edge that made it, read as a consistent pair.
+// The encoder has a single channel so the speed derived from it assumes we are driving forwards.
+uint32_t readEncoder(uint32_t *edge_us) {
+    uint32_t ticks;
+    do {
+        ticks = encoder_ticks;
+        *edge_us = encoder_edge_us;
+    } while (ticks != encoder_ticks); // an edge came in between the two reads
+    return ticks;
+}
+
+void HOT_FUNC(IRQcallback)(uint gpio, uint32_t events) {
     if (events & GPIO_IRQ_EDGE_RISE) {
         rise_time = get_absolute_time();
+        encoder_edge_us = (uint32_t)to_us_since_boot(rise_time);
+        encoder_ticks++; // One slot passed for odometry
     }
 
     if (events & GPIO_IRQ_EDGE_FALL) {
         fall_time = get_absolute_time();
         pulse_width_us = absolute_time_diff_us(rise_time, fall_time);
-        printf("Pulse width: %llu us\n", pulse_width_us); // Debugging statement
+        debug_printf("Pulse width: %llu us\n", pulse_width_us); // Debugging statement
     }
 }
 
@@ -177,18 +239,244 @@ void setupIRQInterrupt() {
     );
 }
 
+// Sleeps until the next control tick, without trying to catch up if a slow echo overran it
+absolute_time_t waitForNextTick(absolute_time_t next_tick) {
+    INSTR_RECORD(tick_time, absolute_time_diff_us(next_tick, get_absolute_time())); // since the tick was due
+    next_tick = delayed_by_ms(next_tick, ControlPeriodMs);
+    if (absolute_time_diff_us(get_absolute_time(), next_tick) < 0) {
+        next_tick = get_absolute_time();
+    }
+    sleep_until(next_tick);
+    return next_tick;
+}
+
+void printEstimate(const range_filter_t *filter) {
+    if (range_filter_valid(filter)) {
+        printf("Distance: %ld cm, closing speed: %ld mm/s\n",
+               RANGE_INT(filter->distance) / 10, RANGE_INT(filter->velocity));
+    } else {
+        printf("Distance: no echo\n");
+    }
+}
+
+#ifndef PIPELINE_MODE
+// Single core: measure and filter in one loop
+void controlLoop() {
+    range_filter_t filter;
+    range_filter_init(&filter);
+    range_odometry_t odometry;
+    range_odometry_init(&odometry, SlotQ8);
+
+    uint32_t tick = 0;
+    uint64_t last_time = time_us_64();
+    absolute_time_t next_tick = get_absolute_time();
+
+    while (1) {
+        // Predict and fold in odometry every control tick, so the estimate keeps moving between pings
+        uint64_t now = time_us_64();
+        uint32_t dt_us = (uint32_t)(now - last_time);
+        uint32_t edge_us;
+        uint32_t ticks = readEncoder(&edge_us);
+        last_time = now;
+
+        INSTR_START(process_time);
+        range_odometry_edges(&odometry, ticks, edge_us);
+        range_filter_predict(&filter, dt_us);
+        range_filter_update_speed(&filter, range_odometry_speed(&odometry, (uint32_t)now));
+        INSTR_STOP(process_time);
+
+        // Correct with an ultrasonic measurement, a timed out echo just lets the estimate coast
+        if (tick % PingEveryNTicks == 0) {
+            uint64_t pulseLength = getPulse();
+            INSTR_START(sample_age); // the echo is in from here, as SAMPLE_ECHO in the pipeline
+            float mm = echoToMm(pulseLength);
+            if (mm == 0) {
+                INSTR_COUNT(echo_timeouts);
+                range_filter_miss(&filter);
+            } else if (!range_filter_update_range(&filter, RANGE_Q8(mm))) {
+                INSTR_COUNT(echo_rejected);
+                printf("Echo rejected: %.0f mm\n", mm); // Debugging statement
+            }
+            INSTR_STOP(sample_age);
+        }
+
+        if (tick % PrintEveryNTicks == 0) {
+            printEstimate(&filter);
+        }
+        INSTR_SNAPSHOT_POLL();
+
+        tick++;
+        next_tick = waitForNextTick(next_tick);
+    }
+}
+#else
+// Core 1: owns the trigger/echo timing, the temperature ADC and the encoder interrupt
+void acquisitionLoop() {
+    setupIRQInterrupt(); // GPIO interrupts are taken on the core that enables them
+
+    uint32_t tick = 0;
+    uint32_t last_ticks = 0;
+    absolute_time_t next_tick = get_absolute_time();
+
+    while (1) {
+        uint32_t edge_us;
+        uint32_t ticks = readEncoder(&edge_us);
+        sample_t sample = {
+            .timestamp_us = time_us_32(),
+            .kind = SAMPLE_ENCODER_EDGE,
+            .channel = EncoderPin,
+            .value = edge_us,
+        };
+        if (ticks != last_ticks) {
+            sample_pipe_push(&sample); // only needed when there is a new edge
+            last_ticks = ticks;
+        }
+        sample.kind = SAMPLE_ENCODER;
+        sample.value = ticks;
+        sample_pipe_push(&sample);
+
+        if (tick % PingEveryNTicks == 0) {
+            sample.timestamp_us = time_us_32();
+            sample.kind = SAMPLE_ADC;
+            sample.channel = TempAdcInput;
+            sample.value = adc_read();
+            sample_pipe_push(&sample);
+
+            // getPulse() can block for the whole echo timeout, so stamp the sample when it returns
+            sample.value = (uint32_t)getPulse();
+            sample.timestamp_us = time_us_32();
+            sample.kind = SAMPLE_ECHO;
+            sample.channel = EchoPin;
+            sample_pipe_push(&sample);
+        }
+
+        tick++;
+        next_tick = waitForNextTick(next_tick);
+    }
+}
+
+// Core 0: turns the sample stream into a distance estimate and does all the printing
+void processingLoop() {
+    range_filter_t filter;
+    range_filter_init(&filter);
+    range_odometry_t odometry;
+    range_odometry_init(&odometry, SlotQ8);
+
+    float temp_buf[NumofSamples] = {0.0f};
+    int temp_index = 0;
+    float temp_sum = 0.0f;
+    float soundSpeed = 0.0f;
+    float conversion_factor = 3.3f / (1 << 12); // Conversion factor for 12-bit ADC
+
+    bool have_encoder = false;
+    uint32_t edge_us = 0;
+    uint32_t last_time = 0;
+    uint32_t last_print = time_us_32();
+    sample_t sample;
+
+    while (1) {
+        sample_pipe_pop(&sample, true);
+
+        INSTR_START(process_time);
+        switch (sample.kind) {
+        case SAMPLE_ENCODER_EDGE:
+            edge_us = sample.value; // goes with the SAMPLE_ENCODER pushed right after it
+            break;
+        case SAMPLE_ENCODER:
+            // Predict and fold in odometry on the acquisition core's clock
+            range_odometry_edges(&odometry, sample.value, edge_us);
+            if (have_encoder) {
+                range_filter_predict(&filter, sample.timestamp_us - last_time);
+                range_filter_update_speed(&filter, range_odometry_speed(&odometry, sample.timestamp_us));
+            }
+            have_encoder = true;
+            last_time = sample.timestamp_us;
+            break;
+        case SAMPLE_ADC: {
+            float value = sample.value * conversion_factor;
+            if (soundSpeed == 0.0f) {
+                // First reading fills the moving average
+                for (size_t i = 0; i < NumofSamples; i++) {
+                    temp_buf[i] = value;
+                }
+                temp_sum = computeTotalVolt(temp_buf);
+            }
+            soundSpeed = soundSpeedFromVolt(movingAvgofSpeed(value, temp_buf, &temp_index, &temp_sum));
+            break;
+        }
+        case SAMPLE_ECHO:
+            if (sample.value == 0 || soundSpeed < 331) {
+                INSTR_COUNT(echo_timeouts);
+                range_filter_miss(&filter);
+            } else {
+                float mm = pulseToMm(sample.value, soundSpeed);
+                if (!range_filter_update_range(&filter, RANGE_Q8(mm))) {
+                    INSTR_COUNT(echo_rejected);
+                    printf("Echo rejected: %.0f mm\n", mm); // Debugging statement
+                }
+            }
+            break;
+        }
+        INSTR_STOP(process_time);
+        INSTR_RECORD(sample_age, time_us_32() - sample.timestamp_us);
+        sample_pipe_done(&sample);
+
+        if (time_us_32() - last_print >= 1000000) {
+            last_print = time_us_32();
+            printEstimate(&filter);
+            sample_pipe_print_stats();
+        }
+        INSTR_SNAPSHOT_POLL();
+    }
+}
+#endif
+
 int main() {
     stdio_init_all();
     setupPins();
-    setupIRQInterrupt();
 
     printf("System initialized. Starting measurements...\n"); // Debugging statement
 
-    while (1) {
-        uint64_t cm = getCm();
-        printf("Distance: %llu cm\n", cm);
-        sleep_ms(1000); // Delay 1 second between measurements
+    INSTR_REGISTER_HISTOGRAM(tick_time);
+    INSTR_REGISTER_HISTOGRAM(sample_age);
+    INSTR_REGISTER_HISTOGRAM(process_time);
+    INSTR_REGISTER_COUNTER(echo_timeouts);
+    INSTR_REGISTER_COUNTER(echo_rejected);
+
+#ifdef PERF_BENCH
+    perf_bench_wait_console();
+    {
+        float bench_buf[NumofSamples] = {0.0f};
+        int bench_index = 0;
+        float bench_sum = 0.0f;
+        PERF_BENCH_RUN("us_moving_avg", 10000,
+            perf_bench_sink += (uint32_t)movingAvgofSpeed((float)perf_bench_i, bench_buf, &bench_index, &bench_sum));
+        PERF_BENCH_RUN("us_total_volt", 10000,
+            perf_bench_sink += (uint32_t)computeTotalVolt(bench_buf));
+        PERF_BENCH_RUN("us_adc_capture", 100, adc_capture(bench_buf));
+
+        range_filter_t bench_filter;
+        range_filter_init(&bench_filter);
+        range_filter_update_range(&bench_filter, RANGE_Q8(1000));
+        range_odometry_t bench_odometry;
+        range_odometry_init(&bench_odometry, SlotQ8);
+        PERF_BENCH_RUN("us_filter_tick", 10000, {
+            // An edge every other tick, roughly 250 mm/s
+            uint32_t now = perf_bench_i * ControlPeriodMs * 1000;
+            range_odometry_edges(&bench_odometry, perf_bench_i / 2, now);
+            range_filter_predict(&bench_filter, ControlPeriodMs * 1000);
+            range_filter_update_speed(&bench_filter, range_odometry_speed(&bench_odometry, now));
+        });
     }
+#endif
+
+#ifdef PIPELINE_MODE
+    sample_pipe_launch(acquisitionLoop);
+    processingLoop();
+#else
+    setupIRQInterrupt();
+    controlLoop();
+#endif
 
     return 0;
 }
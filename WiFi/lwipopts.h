@@ -21,5 +21,12 @@
 #define LWIP_SO_RCVTIMEO 1
 #endif
 
+// The status page server (common/status_http) copies every response, up to ~2.2 kB, into the
+// lwIP heap until it is acked: room for a full response on each of its 4 connections, and a
+// pcb for each plus one for the connection being turned away
+#undef MEM_SIZE
+#define MEM_SIZE 14000
+#define MEMP_NUM_TCP_PCB 6
+
 
 #endif
@@ -10,6 +10,7 @@
 #include "pico/stdlib.h"
 
 #include "lwip/ip4_addr.h"
+#include "lwip/netif.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -19,7 +20,16 @@
 #include "hardware/gpio.h"
 #include "hardware/adc.h"
 
-#define mbaTASK_MESSAGE_BUFFER_SIZE       ( 60 )
+#include "sample_codec.h"
+#include "status_http.h"
+#include "instrument.h"
+
+#define TEMP_SAMPLE_PERIOD_MS             ( 100 )
+#define TEMP_BATCH_SAMPLES                ( 10 )  /* One batch a second */
+#define TEMP_BATCH_BYTES                  ( 64 )  /* ~26 bytes for 10 samples, flushed early if it fills */
+#define mbaTASK_MESSAGE_BUFFER_SIZE       ( 2 * ( TEMP_BATCH_BYTES + sizeof( size_t ) ) )
+
+#define STATUS_HTTP_PORT                  ( 80 )
 
 #ifndef PING_ADDR
 #define PING_ADDR "142.251.35.196"
@@ -32,12 +42,52 @@
 
 static MessageBufferHandle_t xControlMessageBuffer;
 
-float read_onboard_temperature() {
+/* Printed as INSTR snapshots when built with -DINSTRUMENT=ON (tools/instr_report.py). A sample
+   waits at most a batch for its batch to be sent; anything older was held up on the way. */
+INSTR_HISTOGRAM(temp_process_time, "temp_process", 0);
+INSTR_HISTOGRAM(temp_sample_age, "temp_sample_age", (TEMP_BATCH_SAMPLES + 1) * TEMP_SAMPLE_PERIOD_MS * 1000);
+INSTR_COUNTER(temp_batches_dropped, "temp_batches_dropped");
+
+/* Readings served as JSON on http://<ip>/ and as Prometheus text on /metrics */
+static status_page_t status_page;
+static int metric_temperature;
+static int metric_temperature_average;
+static int metric_batches;
+static int metric_batch_bytes;
+static int metric_uptime;
+static int metric_free_heap;
+static int metric_http_requests;
+static int metric_http_rejected;
+static int metric_http_active;
+
+static void status_page_setup(void) {
+    status_page_init(&status_page);
+    metric_temperature = status_page_add(&status_page, "temperature_celsius",
+        "Latest onboard temperature reading", METRIC_GAUGE, 2);
+    metric_temperature_average = status_page_add(&status_page, "temperature_average_celsius",
+        "Moving average of the last 4 batch means", METRIC_GAUGE, 2);
+    metric_batches = status_page_add(&status_page, "temperature_batches_total",
+        "Encoded sample batches received by avg_task", METRIC_COUNTER, 0);
+    metric_batch_bytes = status_page_add(&status_page, "temperature_batch_bytes_total",
+        "Encoded bytes received by avg_task", METRIC_COUNTER, 0);
+    metric_uptime = status_page_add(&status_page, "uptime_seconds",
+        "Seconds since boot", METRIC_COUNTER, 0);
+    metric_free_heap = status_page_add(&status_page, "freertos_free_heap_bytes",
+        "FreeRTOS heap left", METRIC_GAUGE, 0);
+    metric_http_requests = status_page_add(&status_page, "http_requests_total",
+        "HTTP requests answered", METRIC_COUNTER, 0);
+    metric_http_rejected = status_page_add(&status_page, "http_rejected_connections_total",
+        "Connections reset for being over the limit", METRIC_COUNTER, 0);
+    metric_http_active = status_page_add(&status_page, "http_active_connections",
+        "Open HTTP connections", METRIC_GAUGE, 0);
+}
+
+float adc_to_temperature(uint16_t raw) {
     
     /* 12-bit conversion, assume max value == ADC_VREF == 3.3 V */
     const float conversionFactor = 3.3f / (1 << 12);
 
-    float adc = (float)adc_read() * conversionFactor;
+    float adc = (float)raw * conversionFactor;
     float tempC = 27.0f - (adc - 0.706f) / 0.001721f;
 
     return tempC;
@@ -61,9 +111,26 @@ void main_task(__unused void *params) {
     ipaddr_aton(PING_ADDR, &ping_addr);
     ping_init(&ping_addr);
 
+    cyw43_arch_lwip_begin();
+    bool serving = status_http_start(&status_page, STATUS_HTTP_PORT);
+    cyw43_arch_lwip_end();
+    if (serving) {
+        printf("Status page on http://%s/ (%u bytes)\n", ip4addr_ntoa(netif_ip4_addr(netif_list)),
+               (unsigned)(sizeof(status_page) + STATUS_HTTP_MAX_CONNS * sizeof(http_conn_t)));
+    } else {
+        printf("Failed to start the status page server\n");
+    }
+
     while(true) {
         // not much to do as LED is in another task, and we're using RAW (callback) lwIP API
         vTaskDelay(100);
+
+        const http_stats_t *http = status_http_stats();
+        status_page_set(&status_page, metric_uptime, (int32_t)(time_us_64() / 1000000));
+        status_page_set(&status_page, metric_free_heap, (int32_t)xPortGetFreeHeapSize());
+        status_page_set(&status_page, metric_http_requests, (int32_t)http->requests);
+        status_page_set(&status_page, metric_http_rejected, (int32_t)http->rejected);
+        status_page_set(&status_page, metric_http_active, (int32_t)status_http_active());
     }
 
     cyw43_arch_deinit();
@@ -79,31 +146,57 @@ void led_task(__unused void *params) {
     }
 }
 
-/* A Task that obtains the data every 1000 ticks from the inbuilt temperature sensor (RP2040), prints it out and sends it to avg_task via message buffer */
+/* Sends the encoded batch to avg_task via message buffer and starts a new one */
+static void send_temp_batch(sample_encoder_t *encoder) {
+    if (encoder->count > 0) {
+        size_t sent = xMessageBufferSend( 
+            xControlMessageBuffer,    /* The message buffer to write to. */
+            (void *) encoder->buf,    /* The source of the data to send. */
+            encoder->len,             /* The length of the data to send. */
+            0 );                      /* Do not block, should the buffer be full. */
+        if (sent == 0) {
+            INSTR_COUNT(temp_batches_dropped);
+        }
+    }
+    sample_encoder_init(encoder, encoder->buf, TEMP_BATCH_BYTES);
+}
+
+/* A Task that samples the inbuilt temperature sensor (RP2040) every 100 ms, prints it out once a second and sends the raw ADC codes to avg_task as delta/varint encoded batches */
 void temp_task(__unused void *params) {
-    float temperature = 0.0;
+    uint8_t batch[TEMP_BATCH_BYTES];
+    sample_encoder_t encoder;
+    uint16_t raw = 0;
 
     adc_init();
     adc_set_temp_sensor_enabled(true);
     adc_select_input(4);
 
+    sample_encoder_init(&encoder, batch, sizeof(batch));
+
     while(true) {
-        vTaskDelay(1000);
-        temperature = read_onboard_temperature();
-        printf("Onboard temperature = %.02f C\n", temperature);
-        xMessageBufferSend( 
-            xControlMessageBuffer,    /* The message buffer to write to. */
-            (void *) &temperature,    /* The source of the data to send. */
-            sizeof( temperature ),    /* The length of the data to send. */
-            0 );                      /* Do not block, should the buffer be full. */
+        vTaskDelay(pdMS_TO_TICKS(TEMP_SAMPLE_PERIOD_MS));
+        raw = adc_read();
+        uint32_t now = time_us_32();
+        status_page_set(&status_page, metric_temperature, (int32_t)(adc_to_temperature(raw) * 100));
+        if (!sample_encoder_put(&encoder, now, raw)) {
+            send_temp_batch(&encoder);             // Full early, send what we have
+            sample_encoder_put(&encoder, now, raw);
+        }
+        if (encoder.count == TEMP_BATCH_SAMPLES) {
+            printf("Onboard temperature = %.02f C\n", adc_to_temperature(raw));
+            send_temp_batch(&encoder);
+        }
     }
 }
 
-/* A Task that indefinitely waits for data from temp_task via message buffer. Once received, it will calculate the moving average and prints out the result. */
+/* A Task that indefinitely waits for data from temp_task via message buffer. Once received, it will decode the batch, calculate the moving average of the batch means and prints out the result. */
 void avg_task(__unused void *params) {
     float fReceivedData;
     float sum = 0;
     size_t xReceivedBytes;
+    uint8_t batch[TEMP_BATCH_BYTES];
+    sample_decoder_t decoder;
+    uint32_t timestamp, raw;
     
     static float data[4] = {0};
     static int index = 0;
@@ -112,9 +205,27 @@ void avg_task(__unused void *params) {
     while(true) {
         xReceivedBytes = xMessageBufferReceive( 
             xControlMessageBuffer,        /* The message buffer to receive from. */
-            (void *) &fReceivedData,      /* Location to store received data. */
-            sizeof( fReceivedData ),      /* Maximum number of bytes to receive. */
+            (void *) batch,               /* Location to store received data. */
+            sizeof( batch ),              /* Maximum number of bytes to receive. */
             portMAX_DELAY );              /* Wait indefinitely */
+            INSTR_START(temp_process_time);   /* Decode, average and print */
+
+            float batch_sum = 0;
+            int batch_count = 0;
+            sample_decoder_init(&decoder, batch, xReceivedBytes);
+            while (sample_decoder_next(&decoder, &timestamp, &raw)) {
+                batch_sum += adc_to_temperature((uint16_t)raw);
+                batch_count++;
+                INSTR_RECORD(temp_sample_age, time_us_32() - timestamp);
+            }
+            if (decoder.error || batch_count == 0) {
+                printf("Dropped corrupt temperature batch\n");
+                continue;
+            }
+            fReceivedData = batch_sum / batch_count;
+            status_page_set(&status_page, metric_batches, status_page.metrics[metric_batches].value + 1);
+            status_page_set(&status_page, metric_batch_bytes,
+                            status_page.metrics[metric_batch_bytes].value + (int32_t)xReceivedBytes);
 
             sum -= data[index];            // Subtract the oldest element from sum
             data[index] = fReceivedData;   // Assign the new element to the data
@@ -123,11 +234,19 @@ void avg_task(__unused void *params) {
             
             if (count < 4) count++;        // Increment count till it reaches 4
 
+            status_page_set(&status_page, metric_temperature_average, (int32_t)(sum / count * 100));
             printf("Average Temperature = %0.2f C\n", sum / count);
+            INSTR_STOP(temp_process_time);
+            INSTR_SNAPSHOT_POLL();
     }
 }
 
 void vLaunch( void) {
+    status_page_setup();
+    INSTR_REGISTER_HISTOGRAM(temp_process_time);
+    INSTR_REGISTER_HISTOGRAM(temp_sample_age);
+    INSTR_REGISTER_COUNTER(temp_batches_dropped);
+
     TaskHandle_t task;
     xTaskCreate(main_task, "TestMainThread", configMINIMAL_STACK_SIZE, NULL, TEST_TASK_PRIORITY, &task);
     TaskHandle_t ledtask;
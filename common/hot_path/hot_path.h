@@ -0,0 +1,21 @@
+#ifndef HOT_PATH_H
+#define HOT_PATH_H
+
+#include "pico.h"
+
+// Tag functions that sit on a timing path, ISRs included, so they run from SRAM rather than XIP
+// flash:
+//
+//   uint64_t HOT_FUNC(getPulse)() { ... }
+//   void HOT_FUNC(IRQcallback)(uint gpio, uint32_t events) { ... }
+//
+// HOT_FUNC uses the SDK's .time_critical section, which is copied to SRAM at boot so an interrupt
+// or polling loop never waits on a flash cache miss. Define HOT_PATH_IN_FLASH to leave everything
+// in flash (useful to measure the difference). On the host platform it is a no-op.
+#ifdef HOT_PATH_IN_FLASH
+#define HOT_FUNC(func_name) func_name
+#else
+#define HOT_FUNC(func_name) __time_critical_func(func_name)
+#endif
+
+#endif
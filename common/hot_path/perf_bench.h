@@ -0,0 +1,69 @@
+#ifndef PERF_BENCH_H
+#define PERF_BENCH_H
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#if PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#endif
+
+// Set per executable by add_perf_variants() (see perf_variants.cmake)
+#ifndef PERF_TARGET
+#define PERF_TARGET "unknown"
+#endif
+#ifndef PERF_VARIANT
+#define PERF_VARIANT "default"
+#endif
+
+// Start of every BENCH line: "BENCH <target> <variant> ", followed by "<name> <value>\n".
+// tools/perf_report.py files timings under the target, so firmwares sharing a variant don't mix.
+#define PERF_BENCH_PREFIX "BENCH " PERF_TARGET " " PERF_VARIANT " "
+
+// On the board, gives the USB serial console time to connect so the first BENCH lines aren't
+// lost. For firmware that brings stdio up itself; a bench's main() uses perf_bench_begin().
+static inline void perf_bench_wait_console(void) {
+#if PICO_ON_DEVICE
+    sleep_ms(2000);
+#endif
+}
+
+// First thing in a bench's main(): stdio up, then perf_bench_wait_console()
+static inline void perf_bench_begin(void) {
+    stdio_init_all();
+    perf_bench_wait_console();
+}
+
+// Last thing in a bench's main(): prints the OK/FAILED verdict and returns the exit code
+static inline int perf_bench_end(uint32_t errors) {
+    printf(errors ? "FAILED\n" : "OK\n");
+    return errors ? 1 : 0;
+}
+
+// Keeps the compiler from discarding a benchmarked result
+static volatile uint32_t perf_bench_sink;
+
+static inline void perf_bench_print_cycles(const char *name, uint64_t us, uint32_t iterations) {
+#if PICO_ON_DEVICE
+    printf(PERF_BENCH_PREFIX "%s_cycles %.1f\n", name,
+           (double)us * (clock_get_hz(clk_sys) / 1000000) / iterations);
+#else
+    (void)name; (void)us; (void)iterations;
+#endif
+}
+
+// Times `iterations` runs of `stmt` and prints the average in nanoseconds as
+//   BENCH <target> <variant> <name> <ns per iteration>
+// plus, on the board, the same figure in clk_sys cycles as <name>_cycles.
+// tools/perf_report.py picks these lines out of a captured serial log.
+#define PERF_BENCH_RUN(name, iterations, stmt) do {                                 \
+        uint64_t perf_bench_start = time_us_64();                                   \
+        for (uint32_t perf_bench_i = 0; perf_bench_i < (iterations); perf_bench_i++) { \
+            stmt;                                                                   \
+        }                                                                           \
+        uint64_t perf_bench_us = time_us_64() - perf_bench_start;                   \
+        printf(PERF_BENCH_PREFIX "%s %.1f\n", name,                                 \
+               (double)perf_bench_us * 1000.0 / (iterations));                      \
+        perf_bench_print_cycles(name, perf_bench_us, (iterations));                 \
+    } while (0)
+
+#endif
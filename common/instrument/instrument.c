@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include "instrument.h"
+
+#if INSTRUMENT
+
+// Snapshot format, one record per line so it survives being interleaved with other output:
+//
+//   INSTR <ms> begin <sub bits> <max bits>
+//   INSTR <ms> counter <name> <value>
+//   INSTR <ms> hist <name> <deadline us> <count> <misses> <sum us> <max us> <bucket>:<n> ...
+//   INSTR <ms> end
+//
+// <ms> is the time since boot. Everything is cumulative since boot and only non-empty buckets
+// are listed; tools/instr_report.py turns a captured log into percentiles and plots.
+
+static instr_hist_t *histograms[INSTR_MAX_HISTOGRAMS];
+static uint32_t histogram_count;
+static instr_counter_t *counters[INSTR_MAX_COUNTERS];
+static uint32_t counter_count;
+static uint32_t last_snapshot_ms;
+
+bool instr_add_histogram(instr_hist_t *h) {
+    if (histogram_count >= INSTR_MAX_HISTOGRAMS) {
+        return false;
+    }
+    histograms[histogram_count++] = h;
+    return true;
+}
+
+bool instr_add_counter(instr_counter_t *c) {
+    if (counter_count >= INSTR_MAX_COUNTERS) {
+        return false;
+    }
+    counters[counter_count++] = c;
+    return true;
+}
+
+void instr_snapshot(void) {
+    uint32_t ms = to_ms_since_boot(get_absolute_time());
+
+    printf("INSTR %lu begin %d %d\n", (unsigned long)ms, INSTR_SUB_BITS, INSTR_MAX_BITS);
+    for (uint32_t i = 0; i < counter_count; i++) {
+        printf("INSTR %lu counter %s %lu\n", (unsigned long)ms, counters[i]->name,
+               (unsigned long)counters[i]->value);
+    }
+    for (uint32_t i = 0; i < histogram_count; i++) {
+        const instr_hist_t *h = histograms[i];
+        printf("INSTR %lu hist %s %lu %lu %lu %llu %lu", (unsigned long)ms, h->name,
+               (unsigned long)h->deadline_us, (unsigned long)h->count, (unsigned long)h->misses,
+               (unsigned long long)h->sum, (unsigned long)h->max);
+        for (uint32_t b = 0; b < INSTR_BUCKETS; b++) {
+            if (h->buckets[b]) {
+                printf(" %lu:%lu", (unsigned long)b, (unsigned long)h->buckets[b]);
+            }
+        }
+        printf("\n");
+    }
+    printf("INSTR %lu end\n", (unsigned long)ms);
+}
+
+void instr_snapshot_poll(void) {
+    uint32_t ms = to_ms_since_boot(get_absolute_time());
+    if (ms - last_snapshot_ms >= INSTR_SNAPSHOT_PERIOD_MS) {
+        last_snapshot_ms = ms;
+        instr_snapshot();
+    }
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/stdlib.h"
+
+// Stage timing and event counts for the sensor paths, in fixed memory.
+//
+//   INSTR_HISTOGRAM(echo_age, "us_echo_age", 20000); // file scope; deadline in us, 0 for none
+//   INSTR_COUNTER(timeouts, "us_echo_timeouts");
+//
+//   INSTR_REGISTER_HISTOGRAM(echo_age);              // once at start up, before any snapshot
+//   INSTR_REGISTER_COUNTER(timeouts);
+//
+//   INSTR_SCOPE(tick_time);                          // records us from here to the end of the block
+//   INSTR_START(filter_time); ... INSTR_STOP(filter_time); // same for a span that isn't a block
+//   INSTR_RECORD(echo_age, time_us_32() - sample.timestamp_us);
+//   INSTR_COUNT(timeouts);
+//   INSTR_SNAPSHOT_POLL();                           // prints every INSTR_SNAPSHOT_PERIOD_MS
+//
+// Histograms are log-linear over microseconds: exact below 2^INSTR_SUB_BITS, then every power of
+// two is split into 2^INSTR_SUB_BITS equal buckets (at most 25% wide with 2 bits) up to
+// 2^INSTR_MAX_BITS us (~16 s), above which the top bucket takes everything. Values over a
+// histogram's deadline are also counted as misses.
+//
+// Everything here compiles away unless INSTRUMENT is 1 (cmake -DINSTRUMENT=ON): the macros expand
+// to nothing and their arguments are not evaluated, so keep side effects out of them. Update each
+// histogram or counter from one core/task only; a snapshot printed from elsewhere may be slightly
+// torn but never corrupts anything.
+
+#ifndef INSTRUMENT
+#define INSTRUMENT 0
+#endif
+
+#ifndef INSTR_SNAPSHOT_PERIOD_MS
+#define INSTR_SNAPSHOT_PERIOD_MS 5000
+#endif
+
+#define INSTR_SUB_BITS 2
+#define INSTR_MAX_BITS 24
+#define INSTR_BUCKETS ((INSTR_MAX_BITS - INSTR_SUB_BITS + 1) << INSTR_SUB_BITS)
+
+#define INSTR_MAX_HISTOGRAMS 16
+#define INSTR_MAX_COUNTERS 16
+
+#if INSTRUMENT
+
+typedef struct {
+    const char *name;
+    uint32_t deadline_us;   // 0 = no deadline
+    uint32_t count;
+    uint32_t misses;        // values over deadline_us
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[INSTR_BUCKETS];
+} instr_hist_t;
+
+typedef struct {
+    const char *name;
+    uint32_t value;
+} instr_counter_t;
+
+typedef struct {
+    instr_hist_t *hist;
+    uint32_t start;
+} instr_scope_t;
+
+static inline uint32_t instr_bucket(uint32_t value) {
+    if (value < (1u << INSTR_SUB_BITS)) {
+        return value;
+    }
+    if (value >= (1u << INSTR_MAX_BITS)) {
+        return INSTR_BUCKETS - 1;
+    }
+    uint32_t shift = 31 - (uint32_t)__builtin_clz(value) - INSTR_SUB_BITS;
+    return ((shift + 1) << INSTR_SUB_BITS) + ((value >> shift) & ((1u << INSTR_SUB_BITS) - 1));
+}
+
+// Smallest value that lands in bucket `index`
+static inline uint32_t instr_bucket_floor(uint32_t index) {
+    if (index < (1u << INSTR_SUB_BITS)) {
+        return index;
+    }
+    uint32_t shift = (index >> INSTR_SUB_BITS) - 1;
+    return ((1u << INSTR_SUB_BITS) + (index & ((1u << INSTR_SUB_BITS) - 1))) << shift;
+}
+
+static inline void instr_record(instr_hist_t *h, uint32_t value) {
+    h->count++;
+    h->sum += value;
+    if (value > h->max) {
+        h->max = value;
+    }
+    if (h->deadline_us && value > h->deadline_us) {
+        h->misses++;
+    }
+    h->buckets[instr_bucket(value)]++;
+}
+
+static inline void instr_scope_end(instr_scope_t *scope) {
+    instr_record(scope->hist, time_us_32() - scope->start);
+}
+
+// False if the registry is full (raise INSTR_MAX_HISTOGRAMS / INSTR_MAX_COUNTERS)
+bool instr_add_histogram(instr_hist_t *h);
+bool instr_add_counter(instr_counter_t *c);
+
+// Prints every registered histogram and counter, see instrument.c for the line format
+void instr_snapshot(void);
+
+// instr_snapshot() if INSTR_SNAPSHOT_PERIOD_MS has passed since the last one
+void instr_snapshot_poll(void);
+
+#define INSTR_CONCAT_(a, b) a##b
+#define INSTR_CONCAT(a, b) INSTR_CONCAT_(a, b)
+
+#define INSTR_HISTOGRAM(var, label, deadline) static instr_hist_t var = {.name = label, .deadline_us = deadline}
+#define INSTR_COUNTER(var, label) static instr_counter_t var = {.name = label}
+#define INSTR_REGISTER_HISTOGRAM(var) instr_add_histogram(&(var))
+#define INSTR_REGISTER_COUNTER(var) instr_add_counter(&(var))
+#define INSTR_RECORD(var, value) instr_record(&(var), (uint32_t)(value))
+#define INSTR_COUNT(var) ((var).value++)
+#define INSTR_SCOPE(var) \
+    instr_scope_t INSTR_CONCAT(instr_scope_, __LINE__) __attribute__((cleanup(instr_scope_end))) = {&(var), time_us_32()}
+#define INSTR_START(var) instr_scope_t INSTR_CONCAT(var, _timer) = {&(var), time_us_32()}
+#define INSTR_STOP(var) instr_scope_end(&INSTR_CONCAT(var, _timer))
+#define INSTR_SNAPSHOT() instr_snapshot()
+#define INSTR_SNAPSHOT_POLL() instr_snapshot_poll()
+
+#else
+
+// A forward declaration is the only thing that is allowed at file scope and generates nothing
+#define INSTR_HISTOGRAM(var, label, deadline) struct instr_disabled
+#define INSTR_COUNTER(var, label) struct instr_disabled
+#define INSTR_REGISTER_HISTOGRAM(var) ((void)0)
+#define INSTR_REGISTER_COUNTER(var) ((void)0)
+#define INSTR_RECORD(var, value) ((void)0)
+#define INSTR_COUNT(var) ((void)0)
+#define INSTR_SCOPE(var) ((void)0)
+#define INSTR_START(var) ((void)0)
+#define INSTR_STOP(var) ((void)0)
+#define INSTR_SNAPSHOT() ((void)0)
+#define INSTR_SNAPSHOT_POLL() ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "instrument.h"
+#include "perf_bench.h"
+
+// Checks the log-linear bucket mapping (every value lands in a bucket whose range contains it,
+// buckets are ordered and at most 25% wide), times recording a value and a scoped timer, then
+// fills a histogram with a synthetic latency distribution and prints a snapshot, which is handy
+// input for tools/instr_report.py. Always built with INSTRUMENT=1. Exits non-zero on any error.
+
+#define ExhaustiveLimit (1u << 20)
+#define RandomValues 100000
+#define SyntheticValues 20000
+
+INSTR_HISTOGRAM(record_test, "bench_record", 0);
+INSTR_HISTOGRAM(scope_test, "bench_scope", 0);
+INSTR_HISTOGRAM(latency, "bench_latency", 20000);
+INSTR_COUNTER(outliers, "bench_outliers");
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t check_value(uint32_t value, uint32_t *last_bucket) {
+    uint32_t b = instr_bucket(value);
+    uint32_t floor = instr_bucket_floor(b);
+    uint32_t errors = 0;
+    if (b >= INSTR_BUCKETS || floor > value || b < *last_bucket) {
+        errors++;
+    }
+    if (b + 1 < INSTR_BUCKETS) {
+        uint32_t next = instr_bucket_floor(b + 1);
+        if (value >= next || (floor >= (1u << INSTR_SUB_BITS) && (next - floor) * 4 > floor)) {
+            errors++;
+        }
+    }
+    *last_bucket = b;
+    return errors;
+}
+
+static uint32_t check_buckets(void) {
+    uint32_t errors = 0;
+    uint32_t last_bucket = 0;
+    for (uint32_t v = 0; v < ExhaustiveLimit; v++) {
+        errors += check_value(v, &last_bucket);
+    }
+    for (uint32_t shift = 20; shift < 32; shift++) {
+        // Both sides of every power of two above the exhaustive range, in order
+        uint32_t edge = 1u << shift;
+        errors += check_value(edge - 1, &last_bucket);
+        errors += check_value(edge, &last_bucket);
+    }
+    for (uint32_t i = 0; i < RandomValues; i++) {
+        uint32_t unused = 0;
+        errors += check_value(rng() >> (rng() % 32), &unused);
+    }
+    if (instr_bucket(UINT32_MAX) != INSTR_BUCKETS - 1) errors++;
+    printf("buckets   %d buckets, %zu bytes per histogram, %lu errors\n", INSTR_BUCKETS,
+           sizeof(instr_hist_t), (unsigned long)errors);
+    return errors;
+}
+
+static void scoped(void) {
+    INSTR_SCOPE(scope_test);
+    perf_bench_sink++;
+}
+
+int main() {
+    perf_bench_begin();
+
+    INSTR_REGISTER_HISTOGRAM(record_test);
+    INSTR_REGISTER_HISTOGRAM(scope_test);
+    INSTR_REGISTER_HISTOGRAM(latency);
+    INSTR_REGISTER_COUNTER(outliers);
+
+    uint32_t errors = check_buckets();
+
+    PERF_BENCH_RUN("instr_record", 100000, INSTR_RECORD(record_test, perf_bench_i));
+    PERF_BENCH_RUN("instr_scope", 100000, scoped());
+    if (record_test.count != 100000 || scope_test.count != 100000) errors++;
+
+    // Mostly a few ms with a tail past the 20 ms deadline, like a slow echo now and then
+    for (uint32_t i = 0; i < SyntheticValues; i++) {
+        uint32_t value = 2000 + rng() % 3000;
+        if (rng() % 50 == 0) {
+            value += rng() % 60000;
+            INSTR_COUNT(outliers);
+        }
+        INSTR_RECORD(latency, value);
+    }
+    if (latency.count != SyntheticValues || latency.misses == 0 || latency.misses > outliers.value) errors++;
+
+    INSTR_SNAPSHOT();
+
+    return perf_bench_end(errors);
+}
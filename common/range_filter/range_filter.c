@@ -0,0 +1,148 @@
+#include "range_filter.h"
+#include "hot_path.h"
+
+#define MAX_DT_US 1000000
+
+static int32_t saturate(int64_t x) {
+    if (x > INT32_MAX) return INT32_MAX;
+    if (x < INT32_MIN) return INT32_MIN;
+    return (int32_t)x;
+}
+
+// (a * b) >> 16 for a Q16 factor
+static inline int32_t mul_q16(int32_t a, int32_t b) {
+    return saturate(((int64_t)a * b) >> 16);
+}
+
+// num / den as Q16, den > 0
+static inline int32_t div_q16(int32_t num, int64_t den) {
+    return saturate(((int64_t)num << 16) / den);
+}
+
+void range_filter_init(range_filter_t *f) {
+    *f = (range_filter_t) {
+        .accel_var = 1000 * 1000,             // 1 m/s^2 of unmodelled acceleration
+        .range_var = RANGE_Q8(10 * 10),       // +-10 mm ultrasonic noise
+        .speed_var = RANGE_Q8(20 * 20),       // +-20 mm/s: uneven slots and edge timing jitter
+        .init_speed_var = RANGE_Q8(500 * 500),
+        .gate = 4,
+        .max_misses = 5,
+    };
+    f->p11 = f->init_speed_var;
+}
+
+void HOT_FUNC(range_filter_predict)(range_filter_t *f, uint32_t dt_us) {
+    if (dt_us > MAX_DT_US) dt_us = MAX_DT_US;
+    int32_t dt = (int32_t)((dt_us << 10) / 15625); // seconds as Q16 (2^16 / 10^6 == 2^10 / 15625)
+
+    // x = F x with F = [1 -dt; 0 1]
+    f->distance = saturate((int64_t)f->distance - mul_q16(f->velocity, dt));
+
+    // P = F P F' + Q, Q from white acceleration noise: q11 = a dt^2, q01 = a dt^3 / 2 and
+    // q00 = a dt^4 / 4 as Q8. Worked out from dt_us with three extra decimal digits rather than
+    // from the Q16 dt, whose cube and fourth power truncate to 0 at a 20 ms tick. Stays within
+    // 64 bits for accel_var up to 9 * 10^6 at MAX_DT_US.
+    int64_t q11_milli = (int64_t)f->accel_var * dt_us * dt_us / 3906250; // * 2^8 * 10^3 / 10^12
+    int64_t q01_milli = q11_milli * dt_us / 2000000;
+    int64_t q00_milli = q01_milli * dt_us / 2000000;
+    int64_t q11 = q11_milli / 1000;
+    int64_t q01 = q01_milli / 1000;
+    int64_t q00 = q00_milli / 1000;
+    int32_t p01_dt = mul_q16(f->p01, dt);
+    int32_t p11_dt = mul_q16(f->p11, dt);
+    f->p00 = saturate((int64_t)f->p00 - 2 * (int64_t)p01_dt + mul_q16(p11_dt, dt) + q00);
+    f->p01 = saturate((int64_t)f->p01 - p11_dt - q01);
+    f->p11 = saturate((int64_t)f->p11 + q11);
+}
+
+void HOT_FUNC(range_filter_update_speed)(range_filter_t *f, int32_t speed_q8) {
+    // H = [0 1]
+    int64_t s = (int64_t)f->p11 + f->speed_var;
+    int32_t k0 = div_q16(f->p01, s);
+    int32_t k1 = div_q16(f->p11, s);
+    int32_t y = saturate((int64_t)speed_q8 - f->velocity);
+
+    f->distance = saturate((int64_t)f->distance + mul_q16(k0, y));
+    f->velocity = saturate((int64_t)f->velocity + mul_q16(k1, y));
+
+    int32_t p01 = f->p01;
+    f->p00 -= mul_q16(k0, p01);
+    f->p01 -= mul_q16(k1, p01);
+    f->p11 -= mul_q16(k1, f->p11);
+}
+
+bool HOT_FUNC(range_filter_update_range)(range_filter_t *f, int32_t distance_q8) {
+    if (!f->acquired) {
+        // First echo (or first after losing the obstacle): take it as is, keep the velocity
+        f->distance = distance_q8;
+        f->p00 = f->range_var;
+        f->p01 = 0;
+        if (f->p11 < f->init_speed_var) f->p11 = f->init_speed_var;
+        f->acquired = true;
+        f->misses = 0;
+        f->updates++;
+        return true;
+    }
+
+    // H = [1 0]
+    int64_t s = (int64_t)f->p00 + f->range_var;
+    int32_t y = saturate((int64_t)distance_q8 - f->distance);
+
+    // Innovation gate: y^2 > gate^2 * S, both sides in Q8
+    if (f->gate && ((((int64_t)y * y) >> RANGE_FILTER_Q) > (int64_t)f->gate * f->gate * s)) {
+        f->rejected++;
+        if (++f->misses >= f->max_misses) f->acquired = false;
+        return false;
+    }
+
+    int32_t k0 = div_q16(f->p00, s);
+    int32_t k1 = div_q16(f->p01, s);
+
+    f->distance = saturate((int64_t)f->distance + mul_q16(k0, y));
+    f->velocity = saturate((int64_t)f->velocity + mul_q16(k1, y));
+
+    int32_t p01 = f->p01;
+    f->p11 -= mul_q16(k1, p01);
+    f->p01 -= mul_q16(k0, p01);
+    f->p00 -= mul_q16(k0, f->p00);
+
+    f->misses = 0;
+    f->updates++;
+    return true;
+}
+
+void range_filter_miss(range_filter_t *f) {
+    f->timeouts++;
+    if (++f->misses >= f->max_misses) f->acquired = false;
+}
+
+void range_odometry_init(range_odometry_t *o, int32_t slot_q8) {
+    *o = (range_odometry_t) {
+        .slot = slot_q8,
+    };
+}
+
+void HOT_FUNC(range_odometry_edges)(range_odometry_t *o, uint32_t edges, uint32_t edge_us) {
+    if (o->have_edge && edges == o->edges) {
+        return;
+    }
+    if (o->have_edge) {
+        uint32_t period = (edge_us - o->last_edge_us) / (edges - o->edges);
+        o->period_us = period > RANGE_ODOMETRY_STOP_US ? 0 : period; // first edge after a stop
+    }
+    o->have_edge = true;
+    o->edges = edges;
+    o->last_edge_us = edge_us;
+}
+
+int32_t HOT_FUNC(range_odometry_speed)(const range_odometry_t *o, uint32_t now_us) {
+    int32_t since_edge = (int32_t)(now_us - o->last_edge_us);
+    if (o->period_us == 0 || since_edge >= RANGE_ODOMETRY_STOP_US) {
+        return 0;
+    }
+    uint32_t period = o->period_us;
+    if (since_edge > 0 && (uint32_t)since_edge > period) {
+        period = (uint32_t)since_edge; // slowing down: the next edge is already overdue
+    }
+    return saturate((int64_t)o->slot * 1000000 / period);
+}
@@ -0,0 +1,82 @@
+#ifndef RANGE_FILTER_H
+#define RANGE_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 1-D Kalman filter estimating the distance to an obstacle and the speed we are closing in on it.
+//
+// State is [distance, closing velocity]. Call range_filter_predict() and
+// range_filter_update_speed() (wheel odometry) every control tick, and
+// range_filter_update_range() whenever an ultrasonic echo comes back, or range_filter_miss()
+// when it times out. Everything is fixed point so it runs cheaply on the M0+:
+// distances are Q8 mm, velocities Q8 mm/s and the covariances use the same Q8 scaling.
+
+#define RANGE_FILTER_Q 8
+#define RANGE_Q8(x) ((int32_t)((x) * (1 << RANGE_FILTER_Q)))
+#define RANGE_INT(x) ((x) >> RANGE_FILTER_Q)
+
+typedef struct {
+    int32_t distance;       // Q8 mm to the obstacle
+    int32_t velocity;       // Q8 mm/s, positive when closing in
+    int32_t p00, p01, p11;  // covariance: Q8 mm^2, Q8 mm^2/s, Q8 (mm/s)^2
+
+    int32_t accel_var;      // process noise, (mm/s^2)^2 (plain integer)
+    int32_t range_var;      // ultrasonic measurement variance, Q8 mm^2
+    int32_t speed_var;      // odometry speed variance, Q8 (mm/s)^2
+    int32_t init_speed_var; // velocity variance right after (re)acquiring an obstacle, Q8 (mm/s)^2
+    uint8_t gate;           // reject echoes more than this many std devs from the prediction, 0 = off
+    uint8_t max_misses;     // consecutive misses before the estimate is dropped
+
+    uint8_t misses;         // consecutive missed/rejected echoes
+    bool acquired;          // have a distance estimate to work from
+    uint32_t updates;       // echoes accepted
+    uint32_t rejected;      // echoes rejected by the gate
+    uint32_t timeouts;      // echoes that never came back
+} range_filter_t;
+
+// Sets up the filter with noise figures suited to an HC-SR04 and a slotted wheel encoder
+void range_filter_init(range_filter_t *f);
+
+// Advances the estimate by dt_us microseconds (clamped to 1 s)
+void range_filter_predict(range_filter_t *f, uint32_t dt_us);
+
+// Corrects with the closing speed implied by wheel odometry, Q8 mm/s
+void range_filter_update_speed(range_filter_t *f, int32_t speed_q8);
+
+// Corrects with an ultrasonic distance, Q8 mm. Returns false if the echo was gated out.
+bool range_filter_update_range(range_filter_t *f, int32_t distance_q8);
+
+// Records an echo that timed out. After max_misses missed or rejected echoes in a row the
+// estimate is dropped and the next echo is taken as is.
+void range_filter_miss(range_filter_t *f);
+
+// True while the distance estimate is backed by recent echoes
+static inline bool range_filter_valid(const range_filter_t *f) {
+    return f->acquired;
+}
+
+// Closing speed from a single channel slotted wheel encoder, timed edge to edge. Counting slots
+// per control tick would quantise the speed to one slot per tick (510 mm/s with 10.2 mm slots
+// at 20 ms); the time between rising edges resolves it to the microsecond timer instead.
+#define RANGE_ODOMETRY_STOP_US 500000 // no edge for this long means the wheel has stopped
+
+typedef struct {
+    int32_t slot;           // travel per slot, Q8 mm
+    uint32_t edges;         // slot count at last_edge_us
+    uint32_t last_edge_us;  // when the latest rising edge came in
+    uint32_t period_us;     // average time between the last edges, 0 = not known yet
+    bool have_edge;
+} range_odometry_t;
+
+void range_odometry_init(range_odometry_t *o, int32_t slot_q8);
+
+// Feeds the slot count and the time of the edge that made it, read together from the encoder
+// interrupt. Call as often as convenient; nothing changes until the count does.
+void range_odometry_edges(range_odometry_t *o, uint32_t edges, uint32_t edge_us);
+
+// Speed at now_us, Q8 mm/s: one slot over the last edge period, or over the time since the last
+// edge once that is longer (so it falls off when the wheel slows down), 0 once stopped
+int32_t range_odometry_speed(const range_odometry_t *o, uint32_t now_us);
+
+#endif
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "range_filter.h"
+#include "perf_bench.h"
+
+#define ControlPeriodUs 20000 // 50 Hz control loop
+#define PingEveryNTicks 5     // 10 Hz ultrasonic
+#define SimTicks 400
+#define ReacquireTicks (2 * PingEveryNTicks) // valid again within two pings of the echoes returning
+
+// Odometry is simulated as the firmware sees it: whole slots of Ultrasonic's wheel, each edge a
+// little off its nominal position (uneven slots) and timestamped up to IsrLatencyUs late
+#define SlotQ8 (RANGE_Q8(204) / 20) // Ultrasonic.c: WheelCircumferenceMm / EncoderSlots
+#define IsrLatencyUs 20
+#define PreRollUs 100000            // the wheel is already turning when the run starts
+
+typedef struct {
+    const char *name;
+    int32_t start_mm;
+    int32_t speed_mm_s;
+    int32_t noise_mm;      // ultrasonic noise, +-
+    int32_t slot_error_percent; // encoder edge position error, +- % of a slot
+    int32_t drop_percent;  // echoes that time out
+    int32_t outlier_percent; // echoes off a different surface
+    int32_t blackout_from; // run of consecutive timeouts (ticks), 0 = none
+    int32_t blackout_to;
+    uint32_t max_rms_mm;   // limits the run has to stay within
+    uint32_t max_speed_rms;
+    uint32_t min_valid_percent;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    {"clean approach",     2000, 300,  5,  1,  0,  0,   0,   0,  5, 15, 100},
+    {"noisy approach",     2000, 300, 20,  5, 10,  0,   0,   0, 15, 30, 100},
+    {"dropped echoes",     2000, 400, 10,  3, 30,  0,   0,   0, 10, 20, 100},
+    {"echo blackout",      2500, 300, 10,  3,  5,  0, 100, 200, 10, 25,  75},
+    {"spurious echoes",    2000, 300, 10,  3,  5, 10,   0,   0, 10, 25, 100},
+};
+
+static uint32_t rng_state = 1;
+
+// +-range uniform, deterministic so runs can be compared across variants
+static int32_t rng(int32_t range) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (int32_t)((rng_state >> 8) % (uint32_t)(2 * range + 1)) - range;
+}
+
+// When the encoder interrupt stamps the edge after `edges`, for a wheel turning since time 0
+static uint32_t next_edge_us(const scenario_t *s, uint32_t edges) {
+    int64_t position = (int64_t)(edges + 1) * SlotQ8 + rng(SlotQ8 * s->slot_error_percent / 100);
+    int32_t latency = rng(IsrLatencyUs / 2) + IsrLatencyUs / 2;
+    return (uint32_t)(position * 1000000 / RANGE_Q8(s->speed_mm_s) + latency);
+}
+
+typedef struct {
+    uint32_t edges;
+    uint32_t edge_us;       // when the latest edge was stamped
+    uint32_t due_us;        // when the next one will be
+} encoder_sim_t;
+
+// Brings the encoder up to now_us and hands the count to the odometry, like one firmware tick
+static void encoder_tick(encoder_sim_t *e, const scenario_t *s, range_odometry_t *o, uint32_t now_us) {
+    while (e->due_us <= now_us) {
+        e->edges++;
+        e->edge_us = e->due_us;
+        e->due_us = next_edge_us(s, e->edges);
+    }
+    range_odometry_edges(o, e->edges, e->edge_us);
+}
+
+static uint32_t isqrt(uint64_t x) {
+    uint64_t r = 0, bit = 1ull << 62;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+// Returns the number of limits the scenario broke
+static uint32_t run_scenario(const scenario_t *s) {
+    range_filter_t filter;
+    range_filter_init(&filter);
+    range_odometry_t odometry;
+    range_odometry_init(&odometry, SlotQ8);
+    rng_state = 1;
+
+    encoder_sim_t encoder = {.due_us = next_edge_us(s, 0)};
+    for (uint32_t t = ControlPeriodUs; t <= PreRollUs; t += ControlPeriodUs) {
+        encoder_tick(&encoder, s, &odometry, t);
+    }
+
+    int64_t truth = RANGE_Q8(s->start_mm);
+    uint64_t sq_err = 0, sq_raw = 0, sq_vel = 0;
+    uint32_t n = 0, n_raw = 0, n_valid = 0;
+    int32_t reacquired = -1; // first tick with a valid estimate after the blackout
+
+    for (int32_t tick = 0; tick < SimTicks && truth > 0; tick++) {
+        truth -= (int64_t)RANGE_Q8(s->speed_mm_s) * ControlPeriodUs / 1000000;
+        uint32_t now_us = PreRollUs + (uint32_t)(tick + 1) * ControlPeriodUs;
+        encoder_tick(&encoder, s, &odometry, now_us);
+        range_filter_predict(&filter, ControlPeriodUs);
+        range_filter_update_speed(&filter, range_odometry_speed(&odometry, now_us));
+
+        if (tick % PingEveryNTicks == 0) {
+            bool blackout = tick >= s->blackout_from && tick < s->blackout_to;
+            if (blackout || rng(50) + 50 < s->drop_percent) {
+                range_filter_miss(&filter);
+            } else {
+                int32_t measured = (int32_t)truth + RANGE_Q8(rng(s->noise_mm));
+                if (rng(50) + 50 < s->outlier_percent) measured = RANGE_Q8(250); // floor or wall edge
+                range_filter_update_range(&filter, measured);
+                int64_t e = RANGE_INT(measured - truth);
+                sq_raw += e * e;
+                n_raw++;
+            }
+        }
+
+        if (range_filter_valid(&filter)) {
+            int64_t e = RANGE_INT(filter.distance - truth);
+            int64_t ev = RANGE_INT(filter.velocity) - s->speed_mm_s;
+            sq_err += e * e;
+            sq_vel += ev * ev;
+            n_valid++;
+            if (s->blackout_to && reacquired < 0 && tick >= s->blackout_to) {
+                reacquired = tick;
+            }
+        }
+        n++;
+    }
+
+    uint32_t rms = n_valid ? isqrt(sq_err / n_valid) : 0;
+    uint32_t speed_rms = n_valid ? isqrt(sq_vel / n_valid) : 0;
+    uint32_t valid_percent = n ? n_valid * 100 / n : 0;
+    uint32_t errors = 0;
+    if (n_valid == 0 || rms > s->max_rms_mm || speed_rms > s->max_speed_rms) errors++;
+    if (valid_percent < s->min_valid_percent) errors++;
+    if (s->outlier_percent && filter.rejected == 0) errors++; // the gate has to catch some of them
+    if (s->blackout_to && (reacquired < 0 || reacquired - s->blackout_to > ReacquireTicks)) errors++;
+
+    printf("%-16s rms %4lu mm (raw echo %4lu mm), speed rms %4lu mm/s, valid %3lu%%, "
+           "rejected %lu, timeouts %lu",
+           s->name, (unsigned long)rms, n_raw ? (unsigned long)isqrt(sq_raw / n_raw) : 0,
+           (unsigned long)speed_rms, (unsigned long)valid_percent,
+           (unsigned long)filter.rejected, (unsigned long)filter.timeouts);
+    if (s->blackout_to) {
+        printf(", reacquired after %ld ticks", reacquired < 0 ? -1l : (long)(reacquired - s->blackout_to));
+    }
+    printf(errors ? "  FAILED\n" : "  OK\n");
+    return errors;
+}
+
+int main() {
+    perf_bench_begin();
+
+    uint32_t errors = 0;
+    for (size_t i = 0; i < count_of(scenarios); i++) {
+        errors += run_scenario(&scenarios[i]);
+    }
+
+    range_filter_t filter;
+    range_filter_init(&filter);
+    range_filter_update_range(&filter, RANGE_Q8(1000));
+
+    // One control tick, then one echo; alternating small errors keep the gate open
+    PERF_BENCH_RUN("kf_control_tick", 10000, {
+        range_filter_predict(&filter, ControlPeriodUs);
+        range_filter_update_speed(&filter, RANGE_Q8(300) + (int32_t)(perf_bench_i & 0xff));
+    });
+    PERF_BENCH_RUN("kf_range_update", 10000,
+        perf_bench_sink += range_filter_update_range(&filter, filter.distance + (perf_bench_i & 1 ? 256 : -256)));
+    perf_bench_sink += (uint32_t)filter.distance;
+
+    return perf_bench_end(errors);
+}
@@ -0,0 +1,83 @@
+#include "sample_codec.h"
+#include "hot_path.h"
+
+// Writes all five bytes of a varint unconditionally and then advances by its real length, so
+// the only data dependent work is the length calculation. Needs 5 bytes of room.
+static inline uint8_t *put_varint(uint8_t *p, uint32_t v) {
+    uint32_t n = 1u + (v >= (1u << 7)) + (v >= (1u << 14)) + (v >= (1u << 21)) + (v >= (1u << 28));
+    p[0] = (uint8_t)(v | 0x80);
+    p[1] = (uint8_t)((v >> 7) | 0x80);
+    p[2] = (uint8_t)((v >> 14) | 0x80);
+    p[3] = (uint8_t)((v >> 21) | 0x80);
+    p[4] = (uint8_t)(v >> 28);
+    p[n - 1] &= 0x7f;
+    return p + n;
+}
+
+static inline bool get_varint(sample_decoder_t *d, uint32_t *out) {
+    uint32_t v = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        if (d->pos >= d->len) {
+            return false; // truncated
+        }
+        uint8_t b = d->buf[d->pos++];
+        if (shift == 28 && b > 0x0f) {
+            return false; // more than 32 bits
+        }
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+void sample_encoder_init(sample_encoder_t *e, uint8_t *buf, size_t capacity) {
+    *e = (sample_encoder_t) {
+        .buf = buf,
+        .capacity = capacity,
+    };
+}
+
+bool HOT_FUNC(sample_encoder_put)(sample_encoder_t *e, uint32_t timestamp_us, uint32_t value) {
+    if (e->capacity - e->len < SAMPLE_CODEC_MAX_BYTES) {
+        return false;
+    }
+    uint32_t interval = timestamp_us - e->last_timestamp;
+    uint8_t *p = e->buf + e->len;
+    p = put_varint(p, sample_codec_zigzag(interval - e->last_interval));
+    p = put_varint(p, sample_codec_zigzag(value - e->last_value));
+    e->len = (size_t)(p - e->buf);
+    e->last_timestamp = timestamp_us;
+    e->last_interval = e->count ? interval : 0; // the first "interval" is the absolute time
+    e->last_value = value;
+    e->count++;
+    return true;
+}
+
+void sample_decoder_init(sample_decoder_t *d, const uint8_t *buf, size_t len) {
+    *d = (sample_decoder_t) {
+        .buf = buf,
+        .len = len,
+    };
+}
+
+bool HOT_FUNC(sample_decoder_next)(sample_decoder_t *d, uint32_t *timestamp_us, uint32_t *value) {
+    if (d->error || d->pos >= d->len) {
+        return false;
+    }
+    uint32_t interval_delta, value_delta;
+    if (!get_varint(d, &interval_delta) || !get_varint(d, &value_delta)) {
+        d->error = true;
+        return false;
+    }
+    uint32_t interval = d->last_interval + sample_codec_unzigzag(interval_delta);
+    d->last_timestamp += interval;
+    d->last_interval = d->count ? interval : 0; // mirrors sample_encoder_put()
+    d->last_value += sample_codec_unzigzag(value_delta);
+    d->count++;
+    *timestamp_us = d->last_timestamp;
+    *value = d->last_value;
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Packs batches of (timestamp_us, value) integer samples - ADC codes, echo widths, encoder
+// counts - into a compact byte stream.
+//
+// Each sample is two varints: the timestamp as a delta-of-delta (so a steady sample rate costs
+// one byte) and the value as a delta from the previous one, both zigzag encoded so small
+// negative steps stay small. All arithmetic is modulo 2^32, so wrapping timers and counters
+// round trip exactly. A batch starts from zero state, so the first sample carries its absolute
+// time and value, and the second one's interval is coded against zero rather than against that
+// absolute time; there is no header and the decoder simply reads to the end of the buffer.
+
+#define SAMPLE_CODEC_MAX_BYTES 10 // worst case for one sample (two 5-byte varints)
+
+typedef struct {
+    uint8_t *buf;
+    size_t capacity;
+    size_t len;
+    uint32_t count;
+    uint32_t last_timestamp;
+    uint32_t last_interval;
+    uint32_t last_value;
+} sample_encoder_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;
+    uint32_t count;
+    uint32_t last_timestamp;
+    uint32_t last_interval;
+    uint32_t last_value;
+    bool error;             // stream was truncated or malformed
+} sample_decoder_t;
+
+// Starts a new batch in buf
+void sample_encoder_init(sample_encoder_t *e, uint8_t *buf, size_t capacity);
+
+// Appends a sample, false (and nothing added) if the buffer might not have room for it.
+// Scratch bytes may be written past len, never past capacity.
+bool sample_encoder_put(sample_encoder_t *e, uint32_t timestamp_us, uint32_t value);
+
+// Starts reading a batch of len bytes
+void sample_decoder_init(sample_decoder_t *d, const uint8_t *buf, size_t len);
+
+// Reads the next sample; false at the end of the batch or if it is corrupt (d->error set)
+bool sample_decoder_next(sample_decoder_t *d, uint32_t *timestamp_us, uint32_t *value);
+
+static inline uint32_t sample_codec_zigzag(uint32_t v) {
+    return (v << 1) ^ (uint32_t)((int32_t)v >> 31);
+}
+
+static inline uint32_t sample_codec_unzigzag(uint32_t v) {
+    return (v >> 1) ^ (0u - (v & 1));
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "sample_codec.h"
+#include "perf_bench.h"
+
+// Round trips synthetic sensor streams through the codec, reporting compression ratio and
+// encode/decode throughput (MB/s of raw 8-byte samples), then fuzzes it: random streams must
+// round trip exactly, and truncated or random input must decode to a clean prefix or an error
+// without reading past the end. Exits non-zero on any mismatch.
+
+#define StreamSamples 2048
+#define BatchSamples 10 // the size of the wifi temperature batches, where per-batch cost shows
+#define Repeats 20
+#define FuzzRuns 2000
+
+static uint32_t timestamps[StreamSamples];
+static uint32_t values[StreamSamples];
+static uint8_t encoded[StreamSamples * SAMPLE_CODEC_MAX_BYTES];
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// +-range
+static int32_t noise(int32_t range) {
+    return (int32_t)(rng() % (uint32_t)(2 * range + 1)) - range;
+}
+
+typedef enum {
+    STREAM_TEMP_ADC,   // temperature sensor codes, 100 ms
+    STREAM_LINE_ADC,   // IR line sensor codes switching between surfaces, 20 ms
+    STREAM_ECHO_US,    // ultrasonic echo widths with the odd timeout, 100 ms
+    STREAM_ENCODER,    // cumulative encoder slots, 20 ms
+    STREAM_RANDOM,     // incompressible, worst case
+    STREAM_COUNT
+} stream_t;
+
+static const char *stream_names[STREAM_COUNT] = {
+    "temp adc", "line adc", "echo us", "encoder", "random",
+};
+
+// Names for the BENCH lines picked up by tools/perf_report.py
+static const char *stream_ids[STREAM_COUNT] = {
+    "temp", "line", "echo", "encoder", "random",
+};
+
+static void generate(stream_t type, uint32_t n) {
+    uint32_t t = rng();
+    uint32_t v = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        switch (type) {
+        case STREAM_TEMP_ADC:
+            t += 100000 + noise(20);
+            v = (uint32_t)(876 + noise(3));
+            break;
+        case STREAM_LINE_ADC:
+            t += 20000 + noise(20);
+            v = (uint32_t)(((i / 64) & 1 ? 3000 : 300) + noise(40));
+            break;
+        case STREAM_ECHO_US:
+            t += 100000 + noise(500);
+            v = rng() % 50 ? (uint32_t)(5800 - (int32_t)(i * 2) + noise(30)) : 0;
+            break;
+        case STREAM_ENCODER:
+            t += 20000 + noise(20);
+            v += rng() % 4;
+            break;
+        default:
+            t = rng();
+            v = rng();
+            break;
+        }
+        timestamps[i] = t;
+        values[i] = v;
+    }
+}
+
+static size_t encode(uint32_t n) {
+    sample_encoder_t e;
+    sample_encoder_init(&e, encoded, sizeof(encoded));
+    for (uint32_t i = 0; i < n; i++) {
+        sample_encoder_put(&e, timestamps[i], values[i]);
+    }
+    return e.len;
+}
+
+// Encoded size of the stream cut into batches of BatchSamples, each starting from zero state
+static size_t encode_batched(uint32_t n) {
+    size_t total = 0;
+    for (uint32_t first = 0; first < n; first += BatchSamples) {
+        sample_encoder_t e;
+        sample_encoder_init(&e, encoded, sizeof(encoded));
+        for (uint32_t i = first; i < n && i < first + BatchSamples; i++) {
+            sample_encoder_put(&e, timestamps[i], values[i]);
+        }
+        total += e.len;
+    }
+    return total;
+}
+
+// Returns the number of mismatches
+static uint32_t verify(size_t len, uint32_t n) {
+    sample_decoder_t d;
+    sample_decoder_init(&d, encoded, len);
+    uint32_t t, v, i = 0, errors = 0;
+    while (sample_decoder_next(&d, &t, &v)) {
+        if (i >= n || t != timestamps[i] || v != values[i]) errors++;
+        i++;
+    }
+    if (d.error || i != n) errors++;
+    return errors;
+}
+
+static uint32_t benchmark(stream_t type) {
+    generate(type, StreamSamples);
+    size_t batched_len = encode_batched(StreamSamples);
+    size_t len = encode(StreamSamples);
+    uint32_t errors = verify(len, StreamSamples);
+
+    uint64_t start = time_us_64();
+    for (int r = 0; r < Repeats; r++) {
+        len = encode(StreamSamples);
+    }
+    uint64_t encode_us = time_us_64() - start;
+
+    start = time_us_64();
+    for (int r = 0; r < Repeats; r++) {
+        sample_decoder_t d;
+        sample_decoder_init(&d, encoded, len);
+        uint32_t t, v;
+        while (sample_decoder_next(&d, &t, &v)) {
+            perf_bench_sink += v;
+        }
+    }
+    uint64_t decode_us = time_us_64() - start;
+
+    double raw_bytes = (double)StreamSamples * 8 * Repeats;
+    printf("%-9s %5.2f bytes/sample (%5.2f in batches of %d), ratio %5.2f:1, encode %7.2f MB/s, "
+           "decode %7.2f MB/s%s\n",
+           stream_names[type], (double)len / StreamSamples, (double)batched_len / StreamSamples,
+           BatchSamples, (double)StreamSamples * 8 / len,
+           encode_us ? raw_bytes / encode_us : 0.0, decode_us ? raw_bytes / decode_us : 0.0,
+           errors ? ", ROUND TRIP FAILED" : "");
+    printf(PERF_BENCH_PREFIX "codec_encode_%s %.1f\n", stream_ids[type],
+           (double)encode_us * 1000.0 / ((double)StreamSamples * Repeats));
+    printf(PERF_BENCH_PREFIX "codec_decode_%s %.1f\n", stream_ids[type],
+           (double)decode_us * 1000.0 / ((double)StreamSamples * Repeats));
+    return errors;
+}
+
+static uint32_t fuzz(void) {
+    uint32_t errors = 0;
+    for (uint32_t run = 0; run < FuzzRuns; run++) {
+        // Random stream type and length, including empty batches
+        uint32_t n = rng() % 64;
+        generate((stream_t)(rng() % STREAM_COUNT), n);
+        size_t len = encode(n);
+        errors += verify(len, n);
+
+        // An encoder short of room must refuse rather than overrun
+        sample_encoder_t e;
+        size_t capacity = rng() % 64;
+        memset(encoded, 0xa5, sizeof(encoded));
+        sample_encoder_init(&e, encoded, capacity);
+        for (uint32_t i = 0; i < n && sample_encoder_put(&e, timestamps[i], values[i]); i++) {
+        }
+        if (e.len > capacity || encoded[capacity] != 0xa5) errors++;
+
+        // Any prefix decodes to a prefix of the stream, then stops cleanly or with an error
+        len = encode(n);
+        size_t cut = len ? rng() % len : 0;
+        sample_decoder_t d;
+        sample_decoder_init(&d, encoded, cut);
+        uint32_t t, v, i = 0;
+        while (sample_decoder_next(&d, &t, &v)) {
+            if (i >= n || t != timestamps[i] || v != values[i]) errors++;
+            i++;
+        }
+        if (d.pos > cut) errors++;
+
+        // Garbage must terminate without reading past the end
+        size_t garbage = rng() % 64;
+        for (size_t j = 0; j < garbage; j++) {
+            encoded[j] = (uint8_t)rng();
+        }
+        sample_decoder_init(&d, encoded, garbage);
+        while (sample_decoder_next(&d, &t, &v)) {
+        }
+        if (d.pos > garbage) errors++;
+    }
+    printf("fuzz      %d runs, %lu errors\n", FuzzRuns, errors);
+    return errors;
+}
+
+int main() {
+    perf_bench_begin();
+
+    uint32_t errors = 0;
+    for (int type = 0; type < STREAM_COUNT; type++) {
+        errors += benchmark((stream_t)type);
+    }
+    errors += fuzz();
+
+    return perf_bench_end(errors);
+}
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hot_path.h"
+#include "sample_pipe.h"
+
+static sample_ring_t ring;
+static sample_pipe_stats_t stats;
+
+void sample_pipe_launch(void (*core1_entry)(void)) {
+    sample_ring_init(&ring);
+    stats = (sample_pipe_stats_t) {0};
+    multicore_launch_core1(core1_entry);
+}
+
+bool HOT_FUNC(sample_pipe_push)(const sample_t *s) {
+    if (!sample_ring_push(&ring, s)) {
+        return false;
+    }
+    if (multicore_fifo_wready()) {
+        multicore_fifo_push_blocking(ring.pushed); // won't block, there is room
+        stats.doorbells++;
+    } else {
+        stats.fifo_full++; // core 0 is behind, it has wakeups queued already
+    }
+    return true;
+}
+
+bool HOT_FUNC(sample_pipe_pop)(sample_t *out, bool block) {
+    while (!sample_ring_pop(&ring, out)) {
+        if (!block) {
+            return false;
+        }
+        multicore_fifo_pop_blocking(); // sleeps until core 1 rings
+    }
+    // Doorbells for samples that are already in the ring
+    while (multicore_fifo_rvalid()) {
+        multicore_fifo_pop_blocking();
+    }
+    return true;
+}
+
+void HOT_FUNC(sample_pipe_done)(const sample_t *s) {
+    uint32_t latency = time_us_32() - s->timestamp_us;
+    stats.processed++;
+    stats.latency_sum_us += latency;
+    if (latency > stats.latency_max_us) stats.latency_max_us = latency;
+}
+
+uint64_t sample_pipe_time_us_64(const sample_t *s) {
+    uint64_t now = time_us_64();
+    return now - (uint32_t)((uint32_t)now - s->timestamp_us);
+}
+
+void sample_pipe_print_stats(void) {
+    printf("Pipe: pushed %lu, dropped %lu, doorbells %lu, fifo full %lu, ring high water %lu/%d, "
+           "latency avg %lu us max %lu us\n",
+           ring.pushed, ring.dropped, stats.doorbells, stats.fifo_full, ring.high_water, SAMPLE_RING_SIZE,
+           stats.processed ? (uint32_t)(stats.latency_sum_us / stats.processed) : 0,
+           stats.latency_max_us);
+}
@@ -0,0 +1,38 @@
+#ifndef SAMPLE_PIPE_H
+#define SAMPLE_PIPE_H
+
+#include "sample_ring.h"
+
+// Core 1 -> core 0 sample pipeline. Core 1 acquires and calls sample_pipe_push(), which puts
+// the record in a sample_ring_t and rings a doorbell through the SIO inter-core FIFO so core 0
+// can sleep in sample_pipe_pop() instead of polling. The FIFO only carries doorbells: if it is
+// full core 0 already has wakeups pending, so the doorbell is skipped and counted as
+// back-pressure rather than stalling acquisition.
+
+typedef struct {
+    uint32_t doorbells;       // FIFO words sent
+    uint32_t fifo_full;       // doorbells skipped because the FIFO was full
+    uint32_t processed;       // samples passed to sample_pipe_done()
+    uint32_t latency_max_us;  // acquisition to end of processing
+    uint64_t latency_sum_us;
+} sample_pipe_stats_t;
+
+// Core 0: resets the pipe and starts core1_entry on core 1
+void sample_pipe_launch(void (*core1_entry)(void));
+
+// Core 1: queues a sample, false if the ring was full and it was dropped
+bool sample_pipe_push(const sample_t *s);
+
+// Core 0: takes the next sample, sleeping until one arrives if block is set
+bool sample_pipe_pop(sample_t *out, bool block);
+
+// Core 0: call once a sample has been fully processed to record its end-to-end latency
+void sample_pipe_done(const sample_t *s);
+
+// Core 0: the sample's timestamp widened back to 64 bits (valid for samples < 71 minutes old)
+uint64_t sample_pipe_time_us_64(const sample_t *s);
+
+// Core 0: prints ring/FIFO counters and latency since boot
+void sample_pipe_print_stats(void);
+
+#endif
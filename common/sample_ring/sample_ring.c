@@ -0,0 +1,11 @@
+#include <string.h>
+#include "sample_ring.h"
+
+void sample_ring_init(sample_ring_t *r) {
+    memset(r->slots, 0, sizeof(r->slots));
+    atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, 0, memory_order_relaxed);
+    r->pushed = 0;
+    r->dropped = 0;
+    r->high_water = 0;
+}
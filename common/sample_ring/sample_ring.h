@@ -0,0 +1,75 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Single producer / single consumer ring of compact sample records, used to hand samples from
+// the acquisition core to the processing core without locks. Only the producer writes head and
+// only the consumer writes tail; the acquire/release pairs make the slot contents visible
+// before the index that publishes them. Plain 32-bit atomic loads and stores are all it needs,
+// which the M0+ does natively.
+
+#define SAMPLE_RING_SIZE 256 // must be a power of two
+
+enum sample_kind {
+    SAMPLE_ECHO = 1,     // ultrasonic echo width, us (0 = timed out), stamped once it ended or timed out
+    SAMPLE_ADC,          // raw 12-bit ADC code
+    SAMPLE_ENCODER,      // encoder slot count since boot
+    SAMPLE_ENCODER_EDGE, // time_us_32() of the rising edge behind the SAMPLE_ENCODER that follows
+};
+
+typedef struct {
+    uint32_t timestamp_us; // when it was acquired, low 32 bits of time_us_64()
+    uint16_t kind;         // enum sample_kind
+    uint16_t channel;      // ADC input, pin etc.
+    uint32_t value;
+} sample_t;
+
+typedef struct {
+    sample_t slots[SAMPLE_RING_SIZE];
+    _Atomic uint32_t head; // next slot to write, producer only
+    _Atomic uint32_t tail; // next slot to read, consumer only
+
+    // Producer side counters
+    uint32_t pushed;
+    uint32_t dropped;      // ring was full
+    uint32_t high_water;   // most slots ever in use
+} sample_ring_t;
+
+void sample_ring_init(sample_ring_t *r);
+
+// Producer: copies s into the ring, returns false (and counts a drop) if it is full
+static inline bool sample_ring_push(sample_ring_t *r, const sample_t *s) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t used = head - atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (used >= SAMPLE_RING_SIZE) {
+        r->dropped++;
+        return false;
+    }
+    r->slots[head & (SAMPLE_RING_SIZE - 1)] = *s;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    r->pushed++;
+    if (used + 1 > r->high_water) r->high_water = used + 1;
+    return true;
+}
+
+// Consumer: takes the oldest sample, returns false if the ring is empty
+static inline bool sample_ring_pop(sample_ring_t *r, sample_t *out) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&r->head, memory_order_acquire)) {
+        return false;
+    }
+    *out = r->slots[tail & (SAMPLE_RING_SIZE - 1)];
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Either side: samples waiting to be consumed
+static inline uint32_t sample_ring_count(sample_ring_t *r) {
+    return atomic_load_explicit(&r->head, memory_order_acquire) -
+           atomic_load_explicit(&r->tail, memory_order_acquire);
+}
+
+#endif
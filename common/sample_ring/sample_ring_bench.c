@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "sample_ring.h"
+#include "perf_bench.h"
+#if PICO_ON_DEVICE
+#include "pico/multicore.h"
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Hammers the ring from two sides at once: a producer on one thread (core 1 on the board) and a
+// checking consumer on another. Every record carries its sequence number in three fields, so a
+// torn or reordered slot, or a sample seen twice, shows up as an error. Prints the throughput
+// and exits non-zero if anything was inconsistent.
+
+#define SampleCount 1000000u
+
+// The lossy run keeps pace with the consumer like the lossless one, except for a burst of twice
+// the ring every LossyBurstEvery samples that it pushes regardless, so drops and deliveries
+// interleave instead of the producer flooding the ring
+#define LossyBurstEvery (16 * SAMPLE_RING_SIZE)
+#define LossyBurstLength (2 * SAMPLE_RING_SIZE)
+
+// Waiting for the other side; on a host with fewer CPUs than threads spinning would starve it
+#if PICO_ON_DEVICE
+#define wait_for_other_side() tight_loop_contents()
+#else
+#define wait_for_other_side() sched_yield()
+#endif
+
+static sample_ring_t ring;
+static volatile bool lossy; // drop on full instead of waiting for room
+static _Atomic bool producer_done;
+
+static void producer(void) {
+    sample_t sample;
+    for (uint32_t seq = 1; seq <= SampleCount; seq++) {
+        sample.timestamp_us = seq * 3u;
+        sample.kind = SAMPLE_ADC;
+        sample.channel = (uint16_t)seq;
+        sample.value = seq;
+        bool burst = lossy && seq % LossyBurstEvery < LossyBurstLength;
+        while (!burst && sample_ring_count(&ring) >= SAMPLE_RING_SIZE) {
+            wait_for_other_side(); // only the consumer can make room
+        }
+        sample_ring_push(&ring, &sample);
+    }
+    atomic_store_explicit(&producer_done, true, memory_order_release);
+}
+
+#if PICO_ON_DEVICE
+static void core1_entry(void) {
+    producer();
+}
+#else
+static void *producer_thread(void *arg) {
+    (void)arg;
+    producer();
+    return NULL;
+}
+#endif
+
+// Returns the number of inconsistent records
+static uint32_t run(bool drop_when_full) {
+    sample_ring_init(&ring);
+    lossy = drop_when_full;
+    atomic_store_explicit(&producer_done, false, memory_order_relaxed);
+
+    uint64_t start = time_us_64();
+#if PICO_ON_DEVICE
+    multicore_reset_core1();
+    multicore_launch_core1(core1_entry);
+#else
+    pthread_t thread;
+    pthread_create(&thread, NULL, producer_thread, NULL);
+#endif
+
+    uint32_t received = 0, errors = 0, last = 0;
+    sample_t sample;
+    while (last < SampleCount) {
+        if (!sample_ring_pop(&ring, &sample)) {
+            // The producer may have dropped the tail end of the run
+            if (atomic_load_explicit(&producer_done, memory_order_acquire) && sample_ring_count(&ring) == 0) {
+                break;
+            }
+            wait_for_other_side();
+            continue;
+        }
+        if (sample.value <= last || sample.channel != (uint16_t)sample.value ||
+            sample.timestamp_us != sample.value * 3u || sample.kind != SAMPLE_ADC) {
+            errors++;
+        }
+        if (!lossy && sample.value != last + 1) {
+            errors++; // lossless run must see every sequence number
+        }
+        last = sample.value;
+        received++;
+    }
+    uint64_t elapsed = time_us_64() - start;
+
+#if !PICO_ON_DEVICE
+    pthread_join(thread, NULL);
+#endif
+
+    if (received + ring.dropped != SampleCount) {
+        errors++;
+    }
+    if (lossy && (ring.dropped == 0 || ring.dropped > SampleCount / 4)) {
+        errors++; // the bursts have to overflow the ring, and only they may
+    }
+    printf("%-8s %lu samples in %llu us (%.2f M/s), dropped %lu, high water %lu/%d, errors %lu\n",
+           lossy ? "lossy" : "lossless", received, elapsed,
+           elapsed ? (double)received / elapsed : 0.0,
+           ring.dropped, ring.high_water, SAMPLE_RING_SIZE, errors);
+    // ns per pushed sample, dropped or not
+    printf(PERF_BENCH_PREFIX "ring_%s %.1f\n", lossy ? "lossy" : "lossless",
+           (double)elapsed * 1000.0 / SampleCount);
+    return errors;
+}
+
+int main() {
+    perf_bench_begin();
+
+    uint32_t errors = run(false);
+    errors += run(true);
+
+    // Uncontended cost of one push + pop
+    sample_ring_init(&ring);
+    sample_t sample = {0};
+    PERF_BENCH_RUN("ring_push_pop", 100000, {
+        sample.value = perf_bench_i;
+        sample_ring_push(&ring, &sample);
+        sample_ring_pop(&ring, &sample);
+    });
+    perf_bench_sink += sample.value;
+
+    return perf_bench_end(errors);
+}
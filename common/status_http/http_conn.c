@@ -0,0 +1,149 @@
+#include <string.h>
+#include "http_conn.h"
+
+#define STR_CHUNK(s) ((http_chunk_t) {s, sizeof(s) - 1})
+
+static const char keep_alive_line[] = "Connection: keep-alive\r\n\r\n";
+static const char close_line[] = "Connection: close\r\n\r\n";
+
+static const char not_found_head[] =
+    "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 10\r\n";
+static const char not_found_body[] = "not found\n";
+static const char bad_method_head[] =
+    "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET, HEAD\r\nContent-Length: 0\r\n";
+static const char bad_request_head[] =
+    "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n";
+static const char too_large_head[] =
+    "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\n";
+
+bool http_conn_recv(http_conn_t *c, const void *data, size_t len) {
+    if (c->overflow || len > sizeof(c->buf) - c->len) {
+        c->overflow = true;
+        return false;
+    }
+    memcpy(c->buf + c->len, data, len);
+    c->len += len;
+    return true;
+}
+
+// Offset just past the blank line ending the request head, 0 if it hasn't all arrived
+static size_t find_head_end(const char *buf, size_t len) {
+    for (size_t i = 3; i < len; i++) {
+        if (buf[i] == '\n' && buf[i - 1] == '\r' && buf[i - 2] == '\n' && buf[i - 3] == '\r') {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static bool starts_with(const char *s, const char *end, const char *prefix) {
+    size_t n = strlen(prefix);
+    return (size_t)(end - s) >= n && memcmp(s, prefix, n) == 0;
+}
+
+static char lower(char ch) {
+    return ch >= 'A' && ch <= 'Z' ? (char)(ch - 'A' + 'a') : ch;
+}
+
+// Case insensitive search for needle (lower case) in [s, end)
+static bool contains_nocase(const char *s, const char *end, const char *needle) {
+    size_t n = strlen(needle);
+    for (; (size_t)(end - s) >= n; s++) {
+        size_t i = 0;
+        while (i < n && lower(s[i]) == needle[i]) i++;
+        if (i == n) return true;
+    }
+    return false;
+}
+
+// Applies any Connection header in the header lines [s, end) to keep_alive
+static bool connection_keep_alive(const char *s, const char *end, bool keep_alive) {
+    while (s < end) {
+        const char *eol = memchr(s, '\n', (size_t)(end - s));
+        if (!eol) eol = end;
+        if ((size_t)(eol - s) > 11 && contains_nocase(s, s + 11, "connection:")) {
+            if (contains_nocase(s + 11, eol, "close")) keep_alive = false;
+            else if (contains_nocase(s + 11, eol, "keep-alive")) keep_alive = true;
+        }
+        s = eol + 1;
+    }
+    return keep_alive;
+}
+
+static void respond(http_response_t *resp, const char *head, size_t head_len,
+                    const char *body, size_t body_len, bool keep_alive) {
+    resp->count = 0;
+    resp->chunks[resp->count++] = (http_chunk_t) {head, head_len};
+    resp->chunks[resp->count++] = keep_alive ? STR_CHUNK(keep_alive_line) : STR_CHUNK(close_line);
+    if (body_len) {
+        resp->chunks[resp->count++] = (http_chunk_t) {body, body_len};
+    }
+    resp->len = 0;
+    for (uint32_t i = 0; i < resp->count; i++) {
+        resp->len += resp->chunks[i].len;
+    }
+    resp->close = !keep_alive;
+}
+
+bool http_conn_next(http_conn_t *c, status_page_t *page, http_stats_t *stats, http_response_t *resp) {
+    if (c->overflow) {
+        stats->bad_requests++;
+        respond(resp, too_large_head, sizeof(too_large_head) - 1, NULL, 0, false);
+        c->len = 0;
+        c->overflow = false;
+        return true;
+    }
+    size_t head_len = find_head_end(c->buf, c->len);
+    if (!head_len) {
+        return false;
+    }
+    const char *s = c->buf;
+    const char *end = c->buf + head_len;
+    const char *eol = memchr(s, '\n', head_len);
+
+    // Request line: METHOD SP target SP HTTP/x.y
+    bool head_only = starts_with(s, eol, "HEAD ");
+    bool get = starts_with(s, eol, "GET ");
+    const char *target = memchr(s, ' ', (size_t)(eol - s));
+    const char *target_end = target ? memchr(target + 1, ' ', (size_t)(eol - target - 1)) : NULL;
+
+    stats->requests++;
+    if (!target || !target_end || !starts_with(target_end + 1, eol, "HTTP/1.")) {
+        stats->bad_requests++;
+        respond(resp, bad_request_head, sizeof(bad_request_head) - 1, NULL, 0, false);
+    } else if (!get && !head_only) {
+        stats->bad_requests++;
+        respond(resp, bad_method_head, sizeof(bad_method_head) - 1, NULL, 0, false);
+    } else {
+        bool keep_alive = connection_keep_alive(eol + 1, end, starts_with(target_end + 1, eol, "HTTP/1.1"));
+
+        target++;
+        const char *query = memchr(target, '?', (size_t)(target_end - target));
+        if (query) target_end = query;
+        size_t target_len = (size_t)(target_end - target);
+
+        const status_doc_t *doc = NULL;
+        if ((target_len == 1 && target[0] == '/') ||
+            (target_len == 7 && memcmp(target, "/status", 7) == 0)) {
+            doc = &page->json;
+        } else if (target_len == 8 && memcmp(target, "/metrics", 8) == 0) {
+            doc = &page->prom;
+        }
+
+        if (doc) {
+            status_page_render(page);
+            respond(resp, doc->head, doc->head_len, head_only ? NULL : doc->body,
+                    head_only ? 0 : doc->body_len, keep_alive);
+        } else {
+            respond(resp, not_found_head, sizeof(not_found_head) - 1,
+                    head_only ? NULL : not_found_body, head_only ? 0 : sizeof(not_found_body) - 1,
+                    keep_alive);
+        }
+    }
+    stats->bytes_sent += resp->len;
+
+    // Keep anything pipelined after this request
+    memmove(c->buf, c->buf + head_len, c->len - head_len);
+    c->len -= head_len;
+    return true;
+}
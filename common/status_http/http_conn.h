@@ -0,0 +1,68 @@
+#ifndef HTTP_CONN_H
+#define HTTP_CONN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "status_page.h"
+
+// Transport independent half of the status server: buffers the bytes of one connection,
+// splits them into requests and answers each with pointers into the status page's prebuilt
+// documents. The lwIP glue (status_http.h) and the host socket stand-in only move bytes.
+//
+//   GET /  or /status   JSON
+//   GET /metrics        Prometheus text
+//   HEAD                same, without the body
+//
+// HTTP/1.1 connections are kept alive unless the client asks otherwise, HTTP/1.0 ones only if
+// it asks for keep-alive.
+
+#define HTTP_REQUEST_BYTES 1024
+#define HTTP_MAX_CHUNKS 3
+
+typedef struct {
+    const char *data;
+    size_t len;
+} http_chunk_t;
+
+// Response as a list of buffers to send in order, then close if `close` is set
+typedef struct {
+    http_chunk_t chunks[HTTP_MAX_CHUNKS];
+    uint32_t count;
+    size_t len;
+    bool close;
+} http_response_t;
+
+typedef struct {
+    char buf[HTTP_REQUEST_BYTES];
+    size_t len;
+    bool overflow;          // request didn't fit, answer 431 and close
+} http_conn_t;
+
+// Counters shared by every connection of a server
+typedef struct {
+    uint32_t accepted;
+    uint32_t rejected;      // over the connection limit
+    uint32_t requests;
+    uint32_t bad_requests;  // malformed, unsupported or oversized
+    uint32_t bytes_sent;
+} http_stats_t;
+
+static inline void http_conn_init(http_conn_t *c) {
+    c->len = 0;
+    c->overflow = false;
+}
+
+// Appends received bytes; false if the request is larger than the buffer (caller should
+// answer with http_conn_next() once more, which returns the 431 response, then close)
+bool http_conn_recv(http_conn_t *c, const void *data, size_t len);
+
+// If a complete request is buffered, consumes it and fills in the response. Renders the page
+// first if it is stale. The response points into `page` and static strings and stays valid
+// until the next render.
+bool http_conn_next(http_conn_t *c, status_page_t *page, http_stats_t *stats, http_response_t *resp);
+
+// Upper bound on the size of any response, to check for send buffer space up front
+#define HTTP_MAX_RESPONSE_BYTES (STATUS_HEAD_BYTES + 32 + STATUS_PROM_BYTES)
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef STATUS_HTTP_H
+#define STATUS_HTTP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "status_page.h"
+#include "http_conn.h"
+
+// Minimal lwIP raw API HTTP server for a status_page_t (see http_conn.h for the endpoints).
+// At most STATUS_HTTP_MAX_CONNS clients are served at once; further connections are reset
+// straight away and counted. Idle keep-alive connections are closed after
+// STATUS_HTTP_IDLE_TIMEOUT_S. All memory is static: one http_conn_t per slot plus lwIP's
+// own pcbs and pbufs.
+//
+// Call with the lwIP lock held (cyw43_arch_lwip_begin/end) when not on the tcpip thread.
+
+#ifndef STATUS_HTTP_MAX_CONNS
+#define STATUS_HTTP_MAX_CONNS 4
+#endif
+
+#ifndef STATUS_HTTP_IDLE_TIMEOUT_S
+#define STATUS_HTTP_IDLE_TIMEOUT_S 10
+#endif
+
+// Starts listening on port; false if lwIP couldn't set up the listening pcb
+bool status_http_start(status_page_t *page, uint16_t port);
+
+// Server counters (accepted/rejected connections, requests, bytes)
+const http_stats_t *status_http_stats(void);
+
+// Connections currently open
+uint32_t status_http_active(void);
+
+#endif
@@ -0,0 +1,370 @@
+#define _GNU_SOURCE // memmem, MSG_MORE
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "status_http.h"
+#include "perf_bench.h"
+
+// Host stand-in for the lwIP server: the same status_page_t and http_conn_t request handling
+// behind a poll() loop on POSIX sockets, with the same connection limit and idle timeout. The
+// client side checks the endpoints and error responses, measures requests/s with keep-alive
+// against a new connection per request, checks that connections over the limit are reset, and
+// prints the static memory the server needs. Exits non-zero on any failure.
+
+#define KeepAliveRequests 20000
+#define ConnectRequests 2000
+#define UpdateEveryNRequests 100    // value changes between requests, so some renders happen
+
+static status_page_t page;
+static int temperature_metric;
+static int uptime_metric;
+
+static http_stats_t stats;
+static atomic_bool stop_server;
+static int listen_fd;
+static uint16_t port;
+
+typedef struct {
+    int fd;                 // -1 when the slot is free
+    http_conn_t http;
+    uint64_t last_active_us;
+} conn_slot_t;
+
+static conn_slot_t slots[STATUS_HTTP_MAX_CONNS];
+
+static bool send_all(int fd, const char *data, size_t len, int flags) {
+    while (len) {
+        ssize_t n = send(fd, data, len, flags | MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void close_slot(conn_slot_t *slot) {
+    close(slot->fd);
+    slot->fd = -1;
+}
+
+// Same shape as serve() in status_http_lwip.c: answer everything complete, close if asked
+static void serve(conn_slot_t *slot) {
+    http_response_t resp;
+    while (http_conn_next(&slot->http, &page, &stats, &resp)) {
+        for (uint32_t i = 0; i < resp.count; i++) {
+            int flags = i + 1 < resp.count ? MSG_MORE : 0;
+            if (!send_all(slot->fd, resp.chunks[i].data, resp.chunks[i].len, flags)) {
+                close_slot(slot);
+                return;
+            }
+        }
+        if (resp.close) {
+            close_slot(slot);
+            return;
+        }
+    }
+}
+
+static void accept_conn(void) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    conn_slot_t *slot = NULL;
+    for (uint32_t i = 0; i < STATUS_HTTP_MAX_CONNS; i++) {
+        if (slots[i].fd < 0) {
+            slot = &slots[i];
+            break;
+        }
+    }
+    if (!slot) {
+        // Reset rather than close, like tcp_abort()
+        struct linger reset = {.l_onoff = 1, .l_linger = 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        close(fd);
+        stats.rejected++;
+        return;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    stats.accepted++;
+    slot->fd = fd;
+    slot->last_active_us = time_us_64();
+    http_conn_init(&slot->http);
+}
+
+static void *server_thread(void *arg) {
+    struct pollfd fds[STATUS_HTTP_MAX_CONNS + 1];
+    conn_slot_t *owners[STATUS_HTTP_MAX_CONNS + 1];
+    char buf[512];
+
+    for (uint32_t i = 0; i < STATUS_HTTP_MAX_CONNS; i++) {
+        slots[i].fd = -1;
+    }
+    while (!atomic_load(&stop_server)) {
+        nfds_t n = 0;
+        fds[n++] = (struct pollfd) {.fd = listen_fd, .events = POLLIN};
+        for (uint32_t i = 0; i < STATUS_HTTP_MAX_CONNS; i++) {
+            if (slots[i].fd >= 0) {
+                owners[n] = &slots[i];
+                fds[n++] = (struct pollfd) {.fd = slots[i].fd, .events = POLLIN};
+            }
+        }
+        if (poll(fds, n, 50) < 0) break;
+
+        uint64_t now = time_us_64();
+        for (nfds_t i = 1; i < n; i++) {
+            conn_slot_t *slot = owners[i];
+            if (!fds[i].revents) {
+                if (now - slot->last_active_us > STATUS_HTTP_IDLE_TIMEOUT_S * 1000000ull) {
+                    close_slot(slot);
+                }
+                continue;
+            }
+            ssize_t len = recv(slot->fd, buf, sizeof(buf), 0);
+            if (len <= 0) {
+                close_slot(slot);
+                continue;
+            }
+            http_conn_recv(&slot->http, buf, (size_t)len);
+            slot->last_active_us = now;
+            serve(slot);
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_conn();
+        }
+    }
+    for (uint32_t i = 0; i < STATUS_HTTP_MAX_CONNS; i++) {
+        if (slots[i].fd >= 0) close_slot(&slots[i]);
+    }
+    return NULL;
+}
+
+static bool start_server(pthread_t *thread) {
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t addr_len = sizeof(addr);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listen_fd, 16) < 0 || getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) < 0) {
+        perror("listen");
+        return false;
+    }
+    port = ntohs(addr.sin_port);
+    return pthread_create(thread, NULL, server_thread, NULL) == 0;
+}
+
+// Client side
+
+typedef struct {
+    int fd;
+    char buf[4096];
+    size_t len;
+    int status;
+    bool closed;            // server sent Connection: close
+    size_t body_len;
+    char body[STATUS_PROM_BYTES + 1];
+} client_t;
+
+static bool client_connect(client_t *c) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port),
+                               .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    c->len = 0;
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return c->fd >= 0 && connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+}
+
+static void client_close(client_t *c) {
+    close(c->fd);
+    c->fd = -1;
+}
+
+// Reads one response; false if the connection ended or reset first
+static bool client_read(client_t *c, bool head_only) {
+    char *head_end;
+    while (!(head_end = memmem(c->buf, c->len, "\r\n\r\n", 4))) {
+        ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+        if (n <= 0) return false;
+        c->len += (size_t)n;
+    }
+    size_t head_len = (size_t)(head_end + 4 - c->buf);
+    *head_end = '\0';
+
+    c->status = atoi(c->buf + 9);
+    c->closed = strstr(c->buf, "Connection: close") != NULL;
+    const char *length = strstr(c->buf, "Content-Length: ");
+    size_t content_length = length ? (size_t)atoi(length + 16) : 0;
+    c->body_len = head_only ? 0 : content_length;
+
+    while (c->len < head_len + c->body_len) {
+        ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+        if (n <= 0) return false;
+        c->len += (size_t)n;
+    }
+    memcpy(c->body, c->buf + head_len, c->body_len);
+    c->body[c->body_len] = '\0';
+    memmove(c->buf, c->buf + head_len + c->body_len, c->len - head_len - c->body_len);
+    c->len -= head_len + c->body_len;
+    return true;
+}
+
+static bool client_request(client_t *c, const char *request, bool head_only) {
+    return send_all(c->fd, request, strlen(request), 0) && client_read(c, head_only);
+}
+
+static uint32_t failures;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static void check_endpoints(void) {
+    client_t c;
+    check(client_connect(&c), "connect");
+
+    check(client_request(&c, "GET / HTTP/1.1\r\nHost: pico\r\n\r\n", false) && c.status == 200 &&
+          !c.closed && c.body[0] == '{' && strstr(c.body, "\"temperature\":") != NULL, "GET / json");
+    check(client_request(&c, "GET /status?x=1 HTTP/1.1\r\n\r\n", false) && c.status == 200 &&
+          c.body[0] == '{', "GET /status with query");
+    check(client_request(&c, "GET /metrics HTTP/1.1\r\n\r\n", false) && c.status == 200 &&
+          strstr(c.body, "# TYPE temperature gauge\ntemperature 25.12\n") != NULL, "GET /metrics");
+    check(client_request(&c, "HEAD /metrics HTTP/1.1\r\n\r\n", true) && c.status == 200 &&
+          c.len == 0, "HEAD /metrics has no body");
+    check(client_request(&c, "GET /nope HTTP/1.1\r\n\r\n", false) && c.status == 404 && !c.closed,
+          "404 keeps the connection");
+
+    // Two requests in one segment get two responses in order
+    const char *pipelined = "GET /status HTTP/1.1\r\n\r\nGET /metrics HTTP/1.1\r\n\r\n";
+    check(send_all(c.fd, pipelined, strlen(pipelined), 0) &&
+          client_read(&c, false) && c.body[0] == '{' &&
+          client_read(&c, false) && c.body[0] == '#', "pipelined requests");
+
+    check(client_request(&c, "POST / HTTP/1.1\r\nContent-Length: 0\r\n\r\n", false) &&
+          c.status == 405 && c.closed, "405 for POST");
+    client_close(&c);
+
+    check(client_connect(&c), "connect");
+    check(client_request(&c, "GET / HTTP/1.0\r\n\r\n", false) && c.closed, "HTTP/1.0 closes");
+    client_close(&c);
+
+    check(client_connect(&c), "connect");
+    check(client_request(&c, "GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n", false) && !c.closed &&
+          client_request(&c, "GET / HTTP/1.1\r\nConnection: close\r\n\r\n", false) && c.closed,
+          "Connection header");
+    client_close(&c);
+
+    check(client_connect(&c), "connect");
+    char big[HTTP_REQUEST_BYTES + 64];
+    memset(big, 'a', sizeof(big));
+    memcpy(big, "GET / HTTP/1.1\r\nX: ", 19);
+    check(send_all(c.fd, big, sizeof(big), 0) && client_read(&c, false) && c.status == 431 && c.closed,
+          "431 for oversized request");
+    client_close(&c);
+
+    check(client_connect(&c), "connect");
+    check(client_request(&c, "garbage\r\n\r\n", false) && c.status == 400 && c.closed, "400");
+    client_close(&c);
+}
+
+static void check_connection_limit(void) {
+    client_t held[STATUS_HTTP_MAX_CONNS];
+    for (uint32_t i = 0; i < STATUS_HTTP_MAX_CONNS; i++) {
+        // A completed request proves the server accepted it before the next connect
+        check(client_connect(&held[i]) && client_request(&held[i], "GET / HTTP/1.1\r\n\r\n", false),
+              "connection within the limit");
+    }
+    client_t extra;
+    check(client_connect(&extra), "connect over the limit");
+    check(!client_request(&extra, "GET / HTTP/1.1\r\n\r\n", false), "connection over the limit is reset");
+    client_close(&extra);
+
+    // Existing connections are unaffected
+    check(client_request(&held[0], "GET / HTTP/1.1\r\n\r\n", false) && held[0].status == 200,
+          "held connection still served");
+    for (uint32_t i = 0; i < STATUS_HTTP_MAX_CONNS; i++) {
+        client_close(&held[i]);
+    }
+    printf("limit     %d connections held, extra connection reset\n", STATUS_HTTP_MAX_CONNS);
+}
+
+static void bench_keep_alive(void) {
+    client_t c;
+    check(client_connect(&c), "connect");
+    uint64_t start = time_us_64();
+    for (uint32_t i = 0; i < KeepAliveRequests; i++) {
+        if (i % UpdateEveryNRequests == 0) {
+            status_page_set(&page, uptime_metric, (int32_t)i);
+        }
+        if (!client_request(&c, "GET /metrics HTTP/1.1\r\n\r\n", false) || c.status != 200) {
+            check(false, "keep-alive request");
+            break;
+        }
+    }
+    uint64_t us = time_us_64() - start;
+    client_close(&c);
+    printf("keepalive %8.0f req/s\n", us ? KeepAliveRequests * 1e6 / us : 0.0);
+    printf(PERF_BENCH_PREFIX "http_keepalive_request %.1f\n", (double)us * 1000.0 / KeepAliveRequests);
+}
+
+static void bench_connect(void) {
+    client_t c;
+    uint64_t start = time_us_64();
+    for (uint32_t i = 0; i < ConnectRequests; i++) {
+        if (!client_connect(&c) ||
+            !client_request(&c, "GET /metrics HTTP/1.1\r\nConnection: close\r\n\r\n", false)) {
+            check(false, "request on a new connection");
+            client_close(&c);
+            break;
+        }
+        client_close(&c);
+    }
+    uint64_t us = time_us_64() - start;
+    printf("connect   %8.0f req/s (new connection per request)\n", us ? ConnectRequests * 1e6 / us : 0.0);
+    printf(PERF_BENCH_PREFIX "http_connect_request %.1f\n", (double)us * 1000.0 / ConnectRequests);
+}
+
+int main() {
+    perf_bench_begin();
+
+    status_page_init(&page);
+    temperature_metric = status_page_add(&page, "temperature", "Onboard temperature in C", METRIC_GAUGE, 2);
+    uptime_metric = status_page_add(&page, "uptime_seconds", "Seconds since boot", METRIC_COUNTER, 0);
+    status_page_set(&page, temperature_metric, 2512);
+
+    pthread_t thread;
+    if (!start_server(&thread)) {
+        return 1;
+    }
+
+    check_endpoints();
+    check_connection_limit();
+    bench_keep_alive();
+    bench_connect();
+
+    atomic_store(&stop_server, true);
+    pthread_join(thread, NULL);
+    close(listen_fd);
+
+    check(stats.rejected >= 1, "rejected connection counted");
+    check(page.overflows == 0, "documents fit their buffers");
+    printf("server    %lu accepted, %lu rejected, %lu requests (%lu bad), %lu bytes, %lu renders\n",
+           (unsigned long)stats.accepted, (unsigned long)stats.rejected, (unsigned long)stats.requests,
+           (unsigned long)stats.bad_requests, (unsigned long)stats.bytes_sent, (unsigned long)page.renders);
+    printf("memory    status page %zu bytes, %d connections x %zu bytes, response at most %d bytes\n",
+           sizeof(status_page_t), STATUS_HTTP_MAX_CONNS, sizeof(http_conn_t), HTTP_MAX_RESPONSE_BYTES);
+
+    return perf_bench_end(failures);
+}
@@ -0,0 +1,158 @@
+#include "lwip/tcp.h"
+#include "status_http.h"
+
+#define POLL_INTERVAL 2 // tcp_poll() counts in 500 ms ticks, so once a second
+
+typedef struct {
+    struct tcp_pcb *pcb;    // NULL when the slot is free
+    http_conn_t http;
+    uint32_t idle_s;
+    bool closing;           // a Connection: close response has been queued
+} conn_slot_t;
+
+static conn_slot_t slots[STATUS_HTTP_MAX_CONNS];
+static status_page_t *status_page;
+static http_stats_t stats;
+
+// Detaches the slot and closes gracefully (queued data still goes out), aborting if lwIP is out
+// of memory for the FIN. Returns what the calling callback should return.
+static err_t close_conn(conn_slot_t *slot) {
+    struct tcp_pcb *pcb = slot->pcb;
+    err_t result = ERR_OK;
+    slot->pcb = NULL;
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_err(pcb, NULL);
+    tcp_poll(pcb, NULL, 0);
+    if (tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+        result = ERR_ABRT;
+    }
+    return result;
+}
+
+// Answers every complete buffered request there is send buffer room for; anything left waits
+// for the sent callback to free up space
+static err_t serve(conn_slot_t *slot) {
+    struct tcp_pcb *pcb = slot->pcb;
+    http_response_t resp;
+
+    while (!slot->closing && tcp_sndbuf(pcb) >= HTTP_MAX_RESPONSE_BYTES &&
+           http_conn_next(&slot->http, status_page, &stats, &resp)) {
+        for (uint32_t i = 0; i < resp.count; i++) {
+            u8_t flags = TCP_WRITE_FLAG_COPY | (i + 1 < resp.count ? TCP_WRITE_FLAG_MORE : 0);
+            if (tcp_write(pcb, resp.chunks[i].data, (u16_t)resp.chunks[i].len, flags) != ERR_OK) {
+                return close_conn(slot); // out of pbufs/segments, let the client retry
+            }
+        }
+        slot->closing = resp.close;
+    }
+    tcp_output(pcb);
+
+    if (slot->closing) {
+        return close_conn(slot);
+    }
+    return ERR_OK;
+}
+
+static err_t recv_cb(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    conn_slot_t *slot = arg;
+    if (!p) {
+        return close_conn(slot); // client closed its side
+    }
+    for (struct pbuf *q = p; q; q = q->next) {
+        http_conn_recv(&slot->http, q->payload, q->len);
+    }
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    slot->idle_s = 0;
+    return serve(slot);
+}
+
+static err_t sent_cb(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    conn_slot_t *slot = arg;
+    slot->idle_s = 0;
+    return serve(slot);
+}
+
+static err_t poll_cb(void *arg, struct tcp_pcb *pcb) {
+    conn_slot_t *slot = arg;
+    slot->idle_s += POLL_INTERVAL / 2;
+    if (slot->idle_s >= STATUS_HTTP_IDLE_TIMEOUT_S) {
+        return close_conn(slot);
+    }
+    return serve(slot);
+}
+
+static void err_cb(void *arg, err_t err) {
+    conn_slot_t *slot = arg;
+    if (slot) {
+        slot->pcb = NULL; // lwIP has already freed the pcb
+    }
+}
+
+static err_t accept_cb(void *arg, struct tcp_pcb *pcb, err_t err) {
+    if (err != ERR_OK || !pcb) {
+        return ERR_VAL;
+    }
+
+    conn_slot_t *slot = NULL;
+    for (uint32_t i = 0; i < STATUS_HTTP_MAX_CONNS; i++) {
+        if (!slots[i].pcb) {
+            slot = &slots[i];
+            break;
+        }
+    }
+    if (!slot) {
+        stats.rejected++;
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+
+    stats.accepted++;
+    slot->pcb = pcb;
+    slot->idle_s = 0;
+    slot->closing = false;
+    http_conn_init(&slot->http);
+
+    tcp_arg(pcb, slot);
+    tcp_recv(pcb, recv_cb);
+    tcp_sent(pcb, sent_cb);
+    tcp_err(pcb, err_cb);
+    tcp_poll(pcb, poll_cb, POLL_INTERVAL);
+    tcp_nagle_disable(pcb); // responses are written whole, don't hold the tail back
+    return ERR_OK;
+}
+
+bool status_http_start(status_page_t *page, uint16_t port) {
+    status_page = page;
+
+    struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb) {
+        return false;
+    }
+    if (tcp_bind(pcb, IP_ANY_TYPE, port) != ERR_OK) {
+        tcp_close(pcb);
+        return false;
+    }
+    struct tcp_pcb *listen_pcb = tcp_listen_with_backlog(pcb, STATUS_HTTP_MAX_CONNS);
+    if (!listen_pcb) {
+        tcp_close(pcb);
+        return false;
+    }
+    tcp_accept(listen_pcb, accept_cb);
+    return true;
+}
+
+const http_stats_t *status_http_stats(void) {
+    return &stats;
+}
+
+uint32_t status_http_active(void) {
+    uint32_t active = 0;
+    for (uint32_t i = 0; i < STATUS_HTTP_MAX_CONNS; i++) {
+        if (slots[i].pcb) active++;
+    }
+    return active;
+}
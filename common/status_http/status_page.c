@@ -0,0 +1,103 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include "status_page.h"
+
+typedef struct {
+    char *buf;
+    size_t capacity;
+    size_t len;
+    bool overflow;
+} writer_t;
+
+static void append(writer_t *w, const char *fmt, ...) {
+    if (w->overflow) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(w->buf + w->len, w->capacity - w->len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= w->capacity - w->len) {
+        w->overflow = true; // keep what fitted, the rest is dropped
+        return;
+    }
+    w->len += (size_t)n;
+}
+
+static void append_value(writer_t *w, const metric_t *m) {
+    int32_t value = m->value;
+    if (m->decimals == 0) {
+        append(w, "%ld", (long)value);
+        return;
+    }
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < m->decimals; i++) scale *= 10;
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    append(w, "%s%lu.%0*lu", value < 0 ? "-" : "", (unsigned long)(magnitude / scale),
+           (int)m->decimals, (unsigned long)(magnitude % scale));
+}
+
+static void finish_doc(status_page_t *page, status_doc_t *doc, writer_t *w, const char *content_type) {
+    if (w->overflow) {
+        page->overflows++;
+    }
+    doc->body_len = w->len;
+    int n = snprintf(doc->head, sizeof(doc->head),
+                     "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %u\r\nCache-Control: no-cache\r\n",
+                     content_type, (unsigned)doc->body_len);
+    doc->head_len = n > 0 && (size_t)n < sizeof(doc->head) ? (size_t)n : 0;
+}
+
+void status_page_init(status_page_t *page) {
+    page->count = 0;
+    page->version = 1; // differs from rendered_version so the first request renders
+    page->rendered_version = 0;
+    page->renders = 0;
+    page->overflows = 0;
+    page->json.body = page->json_body;
+    page->prom.body = page->prom_body;
+}
+
+int status_page_add(status_page_t *page, const char *name, const char *help,
+                    metric_type_t type, uint8_t decimals) {
+    if (page->count >= STATUS_MAX_METRICS) {
+        return -1;
+    }
+    metric_t *m = &page->metrics[page->count];
+    m->name = name;
+    m->help = help;
+    m->type = type;
+    m->decimals = decimals;
+    m->value = 0;
+    page->version++;
+    return (int)page->count++;
+}
+
+void status_page_render(status_page_t *page) {
+    uint32_t version = page->version;
+    if (version == page->rendered_version) {
+        return;
+    }
+
+    writer_t json = {.buf = page->json_body, .capacity = sizeof(page->json_body)};
+    append(&json, "{");
+    for (uint32_t i = 0; i < page->count; i++) {
+        append(&json, "%s\"%s\":", i ? "," : "", page->metrics[i].name);
+        append_value(&json, &page->metrics[i]);
+    }
+    append(&json, "}\n");
+    finish_doc(page, &page->json, &json, "application/json");
+
+    writer_t prom = {.buf = page->prom_body, .capacity = sizeof(page->prom_body)};
+    for (uint32_t i = 0; i < page->count; i++) {
+        const metric_t *m = &page->metrics[i];
+        append(&prom, "# HELP %s %s\n# TYPE %s %s\n%s ", m->name, m->help, m->name,
+               m->type == METRIC_COUNTER ? "counter" : "gauge", m->name);
+        append_value(&prom, m);
+        append(&prom, "\n");
+    }
+    finish_doc(page, &page->prom, &prom, "text/plain; version=0.0.4");
+
+    page->rendered_version = version;
+    page->renders++;
+}
@@ -0,0 +1,75 @@
+#ifndef STATUS_PAGE_H
+#define STATUS_PAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A fixed set of named readings and counters, rendered as JSON and as Prometheus text into
+// preallocated buffers. Setting a value only bumps a version number; the buffers are rebuilt
+// by status_page_render() the next time someone asks and the version has moved, so a burst of
+// requests between sensor updates costs one render.
+//
+// Values are fixed point integers shown with `decimals` digits after the point (2512 with two
+// decimals is 25.12) so rendering needs no float formatting. Values are written with plain
+// 32-bit stores and may be set from another task or core while a render is in progress; the
+// render snapshots the version first, so a value changed mid-render triggers another render.
+
+#define STATUS_MAX_METRICS 16
+#define STATUS_JSON_BYTES 768
+#define STATUS_PROM_BYTES 2048
+#define STATUS_HEAD_BYTES 128
+
+typedef enum {
+    METRIC_GAUGE,
+    METRIC_COUNTER,
+} metric_type_t;
+
+typedef struct {
+    const char *name;       // snake_case, used as the JSON key and Prometheus metric name
+    const char *help;
+    metric_type_t type;
+    uint8_t decimals;
+    volatile int32_t value;
+} metric_t;
+
+// One rendered document: response head (status line, type, length) and body
+typedef struct {
+    char head[STATUS_HEAD_BYTES];
+    size_t head_len;
+    char *body;
+    size_t body_len;
+} status_doc_t;
+
+typedef struct {
+    metric_t metrics[STATUS_MAX_METRICS];
+    uint32_t count;
+    volatile uint32_t version;
+    uint32_t rendered_version;
+    uint32_t renders;       // times the buffers were rebuilt
+    uint32_t overflows;     // renders that ran out of buffer and were truncated
+
+    status_doc_t json;
+    status_doc_t prom;
+    char json_body[STATUS_JSON_BYTES];
+    char prom_body[STATUS_PROM_BYTES];
+} status_page_t;
+
+void status_page_init(status_page_t *page);
+
+// Registers a metric and returns its index, or -1 if the page is full
+int status_page_add(status_page_t *page, const char *name, const char *help,
+                    metric_type_t type, uint8_t decimals);
+
+// Updates a value; only marks the page stale if it actually changed
+static inline void status_page_set(status_page_t *page, int index, int32_t value) {
+    if (page->metrics[index].value != value) {
+        page->metrics[index].value = value;
+        page->version++;
+    }
+}
+
+// Rebuilds the JSON and Prometheus documents if any value changed since the last render
+void status_page_render(status_page_t *page);
+
+#endif
@@ -0,0 +1,148 @@
+# Performance build variants.
+#
+# Follows the pattern in cmake/build_variants: the sources, definitions and libraries of a
+# firmware live in an INTERFACE library, and each variant is just another executable linking it.
+#
+#   add_perf_variants(Ultrasonic Ultrasonic_common)
+#
+# creates Ultrasonic_release (-O2), Ultrasonic_minsize (-Os), Ultrasonic_lto (-O2 + link time
+# optimisation) and Ultrasonic_ram (-O2, whole image copied to SRAM at boot). The copy_to_ram
+# variant only exists on device; on PICO_PLATFORM=host the rest of the matrix is produced so the
+# portable code can be compared the same way.
+#
+# A firmware that can't run from SRAM (or shouldn't be built some other way) passes its own list:
+#
+#   add_perf_variants(wifi wifi_common VARIANTS release minsize lto)
+#
+# Call it after the base executable is set up: its stdio (USB/UART) choice is copied to the
+# variants. Every executable, the base one included, gets PERF_TARGET="<target>" and
+# PERF_VARIANT="<variant>" so benchmark output can be attributed to it; the variants also get
+# NDEBUG so asserts don't skew the numbers. Turn on PERF_BENCH to make the firmwares run their
+# boot-time benchmarks (see common/hot_path/perf_bench.h).
+
+option(PERF_BENCH "Run the boot-time benchmarks in each firmware" OFF)
+set(PERF_BENCH_LOGS "" CACHE STRING "Captured serial logs with BENCH lines to merge into perf_report.md")
+
+set(PERF_VARIANTS release minsize lto ram)
+
+function(add_perf_variants NAME COMMON)
+    cmake_parse_arguments(ARG "" "" "VARIANTS" ${ARGN})
+    if (NOT ARG_VARIANTS)
+        set(ARG_VARIANTS ${PERF_VARIANTS})
+    endif()
+    set(VARIANT_TARGETS ${NAME})
+    target_compile_definitions(${NAME} PRIVATE PERF_TARGET="${NAME}")
+    foreach (VARIANT IN LISTS ARG_VARIANTS)
+        if (VARIANT STREQUAL "ram" AND NOT PICO_ON_DEVICE)
+            continue()
+        endif()
+        set(TARGET ${NAME}_${VARIANT})
+        add_executable(${TARGET})
+        target_link_libraries(${TARGET} ${COMMON})
+        target_compile_definitions(${TARGET} PRIVATE
+                PERF_TARGET="${TARGET}"
+                PERF_VARIANT="${VARIANT}"
+                NDEBUG
+                )
+        if (VARIANT STREQUAL "minsize")
+            target_compile_options(${TARGET} PRIVATE -Os)
+        else()
+            target_compile_options(${TARGET} PRIVATE -O2)
+        endif()
+        if (VARIANT STREQUAL "lto")
+            set_property(TARGET ${TARGET} PROPERTY INTERPROCEDURAL_OPTIMIZATION TRUE)
+        endif()
+        if (PICO_ON_DEVICE)
+            get_target_property(STDIO_USB ${NAME} PICO_TARGET_STDIO_USB)
+            if (STDIO_USB)
+                pico_enable_stdio_usb(${TARGET} ${STDIO_USB})
+            endif()
+            get_target_property(STDIO_UART ${NAME} PICO_TARGET_STDIO_UART)
+            if (NOT STDIO_UART STREQUAL "STDIO_UART-NOTFOUND")
+                pico_enable_stdio_uart(${TARGET} ${STDIO_UART})
+            endif()
+            if (VARIANT STREQUAL "ram")
+                pico_set_binary_type(${TARGET} copy_to_ram)
+            endif()
+            pico_add_extra_outputs(${TARGET})
+        endif()
+        list(APPEND VARIANT_TARGETS ${TARGET})
+    endforeach()
+
+    if (PERF_BENCH)
+        foreach (TARGET IN LISTS VARIANT_TARGETS)
+            target_compile_definitions(${TARGET} PRIVATE PERF_BENCH)
+        endforeach()
+    endif()
+
+    set_property(GLOBAL APPEND PROPERTY PERF_VARIANT_TARGETS ${VARIANT_TARGETS})
+endfunction()
+
+# Builds a self-checking benchmark from common/ the same way on the board and on the host:
+#
+#   add_portable_bench(range_filter_bench
+#           SOURCES ${CMAKE_CURRENT_LIST_DIR}/range_filter_bench.c
+#           LIBRARIES range_filter
+#           [DEFINITIONS ...])
+#
+# Sets up <name>_common (sources, definitions, pico_stdlib, hot_path for perf_bench.h and the
+# given libraries), the <name> executable with USB stdio and UF2 output on device, and its perf
+# variants. The bench's main() starts with perf_bench_begin() and returns perf_bench_end().
+function(add_portable_bench NAME)
+    cmake_parse_arguments(ARG "" "" "SOURCES;LIBRARIES;DEFINITIONS" ${ARGN})
+    add_library(${NAME}_common INTERFACE)
+    target_sources(${NAME}_common INTERFACE ${ARG_SOURCES})
+    if (ARG_DEFINITIONS)
+        target_compile_definitions(${NAME}_common INTERFACE ${ARG_DEFINITIONS})
+    endif()
+    target_link_libraries(${NAME}_common INTERFACE
+            pico_stdlib
+            hot_path
+            ${ARG_LIBRARIES}
+            )
+
+    add_executable(${NAME})
+    target_link_libraries(${NAME} ${NAME}_common)
+    if (PICO_ON_DEVICE)
+        pico_add_extra_outputs(${NAME})
+        pico_enable_stdio_usb(${NAME} 1)
+    endif()
+    add_perf_variants(${NAME} ${NAME}_common)
+endfunction()
+
+# Adds a perf_report target writing perf_report.md in the build directory: flash/RAM use of every
+# variant plus any BENCH timings found in PERF_BENCH_LOGS. Call once, after all subdirectories.
+function(perf_add_report_target)
+    get_property(TARGETS GLOBAL PROPERTY PERF_VARIANT_TARGETS)
+    if (NOT TARGETS)
+        return()
+    endif()
+    find_package(Python3 COMPONENTS Interpreter)
+    if (NOT Python3_Interpreter_FOUND)
+        message("Skipping perf_report as python3 was not found")
+        return()
+    endif()
+    if (CMAKE_OBJDUMP)
+        set(OBJDUMP ${CMAKE_OBJDUMP})
+    else()
+        set(OBJDUMP objdump)
+    endif()
+
+    set(ELF_ARGS)
+    foreach (TARGET IN LISTS TARGETS)
+        list(APPEND ELF_ARGS --elf ${TARGET}=$<TARGET_FILE:${TARGET}>)
+    endforeach()
+    set(BENCH_ARGS)
+    foreach (LOG IN LISTS PERF_BENCH_LOGS)
+        list(APPEND BENCH_ARGS --bench ${LOG})
+    endforeach()
+
+    add_custom_target(perf_report
+            COMMAND ${Python3_EXECUTABLE} ${CMAKE_SOURCE_DIR}/tools/perf_report.py
+                    --objdump ${OBJDUMP} ${ELF_ARGS} ${BENCH_ARGS}
+                    -o ${CMAKE_BINARY_DIR}/perf_report.md
+            DEPENDS ${TARGETS}
+            COMMENT "Generating perf_report.md"
+            VERBATIM
+            )
+endfunction()
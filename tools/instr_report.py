@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+"""Aggregate and plot the INSTR snapshots printed by firmwares built with -DINSTRUMENT=ON.
+
+    instr_report.py ultrasonic.txt irsensor.txt wifi.txt -o instr_report.md --plot plots/
+
+Logs are captured serial output; only lines starting "INSTR " (see common/instrument) are
+used, anything else is ignored. Snapshots are cumulative since boot, so each log is split into
+runs wherever the uptime or a count goes backwards (a reset), the last snapshot of every run is
+summed into the totals, and the differences between consecutive snapshots give the per-interval
+figures that are plotted. Percentiles come from the log-linear buckets and are accurate to the bucket width
+(25% with the default 2 sub-bucket bits). Plotting needs matplotlib; the tables don't.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+LINE_RE = re.compile(r"INSTR (\d+) (begin|end|counter|hist)\b ?(.*)")
+
+
+class Hist:
+    def __init__(self, deadline=0, count=0, misses=0, total=0, maximum=0, buckets=None):
+        self.deadline = deadline
+        self.count = count
+        self.misses = misses
+        self.total = total
+        self.maximum = maximum
+        self.buckets = buckets or {}
+
+    def add(self, other):
+        self.deadline = other.deadline
+        self.count += other.count
+        self.misses += other.misses
+        self.total += other.total
+        self.maximum = max(self.maximum, other.maximum)
+        for b, n in other.buckets.items():
+            self.buckets[b] = self.buckets.get(b, 0) + n
+
+    def minus(self, older):
+        buckets = {b: n - older.buckets.get(b, 0) for b, n in self.buckets.items()}
+        return Hist(self.deadline, self.count - older.count, self.misses - older.misses,
+                    self.total - older.total, self.maximum,
+                    {b: n for b, n in buckets.items() if n > 0})
+
+
+class Snapshot:
+    def __init__(self, ms, sub_bits, max_bits):
+        self.ms = ms
+        self.sub_bits = sub_bits
+        self.max_bits = max_bits
+        self.counters = {}
+        self.hists = {}
+
+
+def bucket_floor(index, sub_bits):
+    # Mirrors instr_bucket_floor() in common/instrument/instrument.h
+    if index < (1 << sub_bits):
+        return index
+    shift = (index >> sub_bits) - 1
+    return ((1 << sub_bits) + (index & ((1 << sub_bits) - 1))) << shift
+
+
+def percentile(hist, q, sub_bits):
+    if hist.count <= 0:
+        return 0
+    rank = q * hist.count
+    seen = 0
+    for b in sorted(hist.buckets):
+        seen += hist.buckets[b]
+        if seen >= rank:
+            low = bucket_floor(b, sub_bits)
+            high = bucket_floor(b + 1, sub_bits)
+            return min((low + high - 1) / 2, hist.maximum) if high - low > 1 else low
+    return hist.maximum
+
+
+def restarted(older, newer):
+    # Cumulative counts only go down if the board was reset between the two
+    return any(h.count < older.hists[name].count for name, h in newer.hists.items() if name in older.hists)
+
+
+def read_runs(path):
+    """List of runs, each a list of complete snapshots in order."""
+    runs = []
+    current = None
+    snap = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = LINE_RE.search(line)
+            if not m:
+                continue
+            ms, kind, rest = int(m.group(1)), m.group(2), m.group(3).split()
+            try:
+                if kind == "begin":
+                    if current is None or (current and ms < current[-1].ms):
+                        current = []
+                        runs.append(current)
+                    snap = Snapshot(ms, int(rest[0]), int(rest[1]))
+                elif snap is None or ms != snap.ms:
+                    snap = None # line of a snapshot whose begin we missed
+                elif kind == "counter":
+                    snap.counters[rest[0]] = int(rest[1])
+                elif kind == "hist":
+                    deadline, count, misses, total, maximum = (int(v) for v in rest[1:6])
+                    buckets = {}
+                    for item in rest[6:]:
+                        b, n = item.split(":")
+                        buckets[int(b)] = int(n)
+                    snap.hists[rest[0]] = Hist(deadline, count, misses, total, maximum, buckets)
+                elif kind == "end":
+                    if current and restarted(current[-1], snap):
+                        current = []
+                        runs.append(current)
+                    current.append(snap)
+                    snap = None
+            except (ValueError, IndexError):
+                snap = None # garbled line (e.g. interleaved output), drop the snapshot
+    return [run for run in runs if run]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("logs", nargs="+", metavar="LOG")
+    parser.add_argument("-o", "--output")
+    parser.add_argument("--plot", metavar="DIR", help="write a PNG per histogram into DIR")
+    args = parser.parse_args()
+
+    runs = []
+    for path in args.logs:
+        for i, run in enumerate(read_runs(path)):
+            runs.append(("%s#%d" % (os.path.basename(path), i + 1), run))
+    if not runs:
+        sys.exit("no INSTR snapshots found")
+
+    sub_bits = runs[0][1][-1].sub_bits
+    hists = {}
+    counters = {}
+    for _, run in runs:
+        last = run[-1]
+        for name, h in last.hists.items():
+            hists.setdefault(name, Hist()).add(h)
+        for name, value in last.counters.items():
+            counters[name] = counters.get(name, 0) + value
+
+    out = ["%d run(s), %d snapshot(s)" % (len(runs), sum(len(run) for _, run in runs)), ""]
+    out.append("| Histogram | Count | Mean (us) | p50 | p90 | p99 | Max | Deadline | Misses |")
+    out.append("|---|---|---|---|---|---|---|---|---|")
+    for name in sorted(hists):
+        h = hists[name]
+        mean = h.total / h.count if h.count else 0
+        misses = "%d (%.2f%%)" % (h.misses, h.misses * 100.0 / h.count) if h.deadline and h.count else "-"
+        out.append("| %s | %d | %.0f | %.0f | %.0f | %.0f | %d | %s | %s |" % (
+            name, h.count, mean, percentile(h, 0.5, sub_bits), percentile(h, 0.9, sub_bits),
+            percentile(h, 0.99, sub_bits), h.maximum, h.deadline or "-", misses))
+    if counters:
+        out += ["", "| Counter | Total |", "|---|---|"]
+        out += ["| %s | %d |" % (name, counters[name]) for name in sorted(counters)]
+    text = "\n".join(out) + "\n"
+
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write("# Instrumentation report\n\n" + text)
+    sys.stdout.write(text)
+
+    if args.plot:
+        plot(args.plot, runs, hists, sub_bits)
+
+
+def plot(directory, runs, hists, sub_bits):
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+    except ImportError:
+        sys.exit("--plot needs matplotlib (pip install matplotlib)")
+
+    os.makedirs(directory, exist_ok=True)
+    for name, h in sorted(hists.items()):
+        fig, (dist, series) = plt.subplots(1, 2, figsize=(12, 4))
+        fig.suptitle(name)
+
+        # Distribution over all runs, one bar per bucket
+        lows = [bucket_floor(b, sub_bits) for b in sorted(h.buckets)]
+        widths = [bucket_floor(b + 1, sub_bits) - bucket_floor(b, sub_bits) for b in sorted(h.buckets)]
+        dist.bar(lows, [h.buckets[b] for b in sorted(h.buckets)], width=widths, align="edge")
+        dist.set_xscale("symlog", linthresh=1 << sub_bits)
+        dist.set_xlabel("us")
+        dist.set_ylabel("samples")
+        if h.deadline:
+            dist.axvline(h.deadline, color="red", linestyle="--", label="deadline")
+            dist.legend()
+
+        # p50/p99 per snapshot interval, and deadline misses on the right axis
+        misses_axis = series.twinx() if h.deadline else None
+        for label, run in runs:
+            t, p50, p99, missed = [], [], [], []
+            for older, newer in zip(run, run[1:]):
+                if name not in newer.hists or name not in older.hists:
+                    continue
+                delta = newer.hists[name].minus(older.hists[name])
+                t.append(newer.ms / 1000.0)
+                p50.append(percentile(delta, 0.5, sub_bits))
+                p99.append(percentile(delta, 0.99, sub_bits))
+                missed.append(delta.misses)
+            if not t:
+                continue
+            series.plot(t, p50, label="%s p50" % label)
+            series.plot(t, p99, label="%s p99" % label)
+            if misses_axis:
+                misses_axis.bar(t, missed, width=0.5, alpha=0.3, color="red")
+        series.set_xlabel("seconds since boot")
+        series.set_ylabel("us")
+        if misses_axis:
+            misses_axis.set_ylabel("deadline misses per interval")
+        if series.lines:
+            series.legend(fontsize="small")
+
+        fig.tight_layout()
+        fig.savefig(os.path.join(directory, "%s.png" % name))
+        plt.close(fig)
+
+
+if __name__ == "__main__":
+    main()
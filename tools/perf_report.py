@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Compare code size, RAM use and benchmark timings across build variants.
+
+    perf_report.py --objdump arm-none-eabi-objdump \\
+        --elf Ultrasonic=build/Ultrasonic/Ultrasonic.elf \\
+        --elf Ultrasonic_ram=build/Ultrasonic/Ultrasonic_ram.elf \\
+        --bench serial_ultrasonic_ram.txt -o perf_report.md
+
+Sizes come from the section headers (objdump -h). "Image" is everything stored in the
+binary (flash on device), "RAM" is everything resident in SRAM at run time, so a
+copy_to_ram build shows its code in both. Bench logs are captured serial output; only
+lines of the form "BENCH <target> <variant> <name> <value>" (see common/hot_path/perf_bench.h)
+are used, and each timing goes on the row of the target that printed it; values are
+nanoseconds, or clk_sys cycles for names ending in _cycles.
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+
+RAM_START = 0x20000000
+RAM_END = 0x30000000
+
+SECTION_RE = re.compile(r"^\s*\d+\s+(\S+)\s+([0-9a-fA-F]+)\s+([0-9a-fA-F]+)\s+([0-9a-fA-F]+)\s")
+BENCH_RE = re.compile(r"BENCH\s+(\S+)\s+(\S+)\s+(\S+)\s+([0-9.]+)")
+
+
+def section_sizes(objdump, elf):
+    out = subprocess.run([objdump, "-h", elf], check=True, capture_output=True, text=True).stdout
+    lines = out.splitlines()
+    on_device = False
+    sections = []
+    for i, line in enumerate(lines):
+        m = SECTION_RE.match(line)
+        if not m or i + 1 >= len(lines):
+            continue
+        flags = lines[i + 1]
+        if "ALLOC" not in flags:
+            continue
+        vma = int(m.group(3), 16)
+        sections.append((int(m.group(2), 16), vma, flags))
+        if 0x10000000 <= vma < RAM_START:
+            on_device = True
+
+    image = ram = 0
+    for size, vma, flags in sections:
+        if "CONTENTS" in flags:
+            image += size
+        if on_device:
+            if RAM_START <= vma < RAM_END:
+                ram += size
+        elif "READONLY" not in flags:
+            # host executables: writable data and bss
+            ram += size
+    return image, ram
+
+
+def read_bench(paths):
+    results = {}
+    for path in paths:
+        with open(path, errors="replace") as f:
+            for line in f:
+                m = BENCH_RE.search(line)
+                if m:
+                    # keyed by target; the variant is implied by it
+                    results.setdefault(m.group(1), {})[m.group(3)] = float(m.group(4))
+    return results
+
+
+def variant_of(target):
+    # Ultrasonic_minsize -> minsize, Ultrasonic -> default
+    for suffix in ("release", "minsize", "lto", "ram"):
+        if target.endswith("_" + suffix):
+            return suffix
+    return "default"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--objdump", default="objdump")
+    parser.add_argument("--elf", action="append", default=[], metavar="TARGET=PATH")
+    parser.add_argument("--bench", action="append", default=[], metavar="LOG")
+    parser.add_argument("-o", "--output")
+    args = parser.parse_args()
+
+    bench = read_bench(args.bench)
+    bench_names = sorted({name for timings in bench.values() for name in timings})
+
+    header = ["Target", "Variant", "Image (bytes)", "RAM (bytes)"]
+    header += [n if n.endswith("_cycles") else "%s (ns)" % n for n in bench_names]
+    rows = []
+    baseline = {}
+    for spec in args.elf:
+        target, path = spec.split("=", 1)
+        image, ram = section_sizes(args.objdump, path)
+        variant = variant_of(target)
+        firmware = target[:-len(variant) - 1] if variant != "default" else target
+        if variant == "default":
+            baseline[firmware] = image
+        row = [target, variant, str(image), str(ram)]
+        for name in bench_names:
+            t = bench.get(target, {}).get(name)
+            row.append("%.1f" % t if t is not None else "-")
+        rows.append((firmware, row, image))
+
+    # image size relative to the default build of the same firmware
+    header.insert(3, "vs default")
+    for firmware, row, image in rows:
+        base = baseline.get(firmware)
+        row.insert(3, "%+.1f%%" % ((image - base) * 100.0 / base) if base else "-")
+
+    out = ["| " + " | ".join(header) + " |", "|" + "---|" * len(header)]
+    out += ["| " + " | ".join(row) + " |" for _, row, _ in rows]
+    text = "\n".join(out) + "\n"
+
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write("# Build variant comparison\n\n" + text)
+    sys.stdout.write(text)
+
+
+if __name__ == "__main__":
+    main()